@@ -0,0 +1,169 @@
+#pragma once
+#ifndef __ACCEL_AABB_HPP__
+#define __ACCEL_AABB_HPP__
+
+#include "scene/Scene.hpp"
+#include "accel/Ray.hpp"
+#include "accel/HitRecord.hpp"
+#include "accel/PlanarRecord.hpp"
+#include "geometry/vec.hpp"
+namespace Accel
+{
+    using namespace NRenderer;
+    using namespace std;
+
+    struct Instance;
+
+    // 紧凑存储的Mesh三角形, 由BVH连续存放: 三个顶点, 预先计算的面法线与材质
+    // 水密求交只需要顶点本身, 与光线有关的剪切变换每条光线只计算一次
+    struct MeshTriangle
+    {
+        Vec3 v0;
+        Vec3 v1;
+        Vec3 v2;
+        Vec3 normal;
+        uint32_t material;  //材质Handle的值
+
+        Handle getMaterial() const {
+            Handle handle;
+            handle.setValue(material);
+            return handle;
+        }
+    };
+    static_assert(sizeof(MeshTriangle) == 52, "MeshTriangle should be 52 bytes");
+
+    //取出mesh的第index个三角形
+    inline MeshTriangle makeMeshTriangle(const Mesh& mesh, int index){
+        MeshTriangle t;
+        t.v0 = mesh.positions[mesh.positionIndices[3 * index]];
+        t.v1 = mesh.positions[mesh.positionIndices[3 * index + 1]];
+        t.v2 = mesh.positions[mesh.positionIndices[3 * index + 2]];
+        t.normal = glm::normalize(glm::cross(t.v1 - t.v0, t.v2 - t.v0));
+        t.material = uint32_t(mesh.material.getValue());
+        return t;
+    }
+    
+    class AABB{
+    public:
+        Vec3 _min;  //左下角
+        Vec3 _max;   //右上角
+        enum class Type
+        {
+            NOLEAF = 0x0,
+            SPHERE = 0x1,
+            TRIANGLE = 0X2,
+            PLANE = 0X3,
+            MESH = 0X4,
+            INSTANCE = 0X5
+        };
+        Type type = Type::NOLEAF;
+        int axis = 0;   //内部节点的划分轴
+        int index = -1; //叶结点: 在构建输入中的序号
+        float sahCost = 0.f;    //treelet重构时使用: 以该节点为根的子树的SAH开销
+        int height = 0;         //treelet重构时使用: 以该节点为根的子树的高度, 叶结点为0
+        int leafSize = 0;       //内部节点: 整棵子树合并为一个叶结点时的图元数, 0表示不合并
+
+        //SharedEntity entity = nullptr;
+        SHARE(AABB);
+        SharedAABB left = nullptr;
+        SharedAABB right = nullptr;
+
+        union
+        {
+            Sphere* sp;
+            Triangle* tr;
+            const PlaneRecord* pl;
+            const MeshTriangle* mt;
+            Instance* in;
+        };
+
+        AABB() = default;
+
+        Vec3 centroid() const {
+            return (_min + _max) * 0.5f;
+        }
+
+        float surfaceArea() const {
+            Vec3 d = _max - _min;
+            return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+        }
+
+        //轴对齐的三角形或平面在某个轴上厚度为0, 按坐标的大小加上极小的厚度, 避免求交时出现0/0
+        void padFlat(){
+            for(int i = 0; i < 3; i++){
+                if(_max[i] > _min[i]) continue;
+                float eps = 1e-5f * std::max(1.f, std::max(fabs(_min[i]), fabs(_max[i])));
+                _min[i] -= eps;
+                _max[i] += eps;
+            }
+        }
+
+        AABB(SharedAABB left, SharedAABB right, int axis = 0){
+            _min = Vec3(fmin(left->_min.x, right->_min.x),
+                        fmin(left->_min.y, right->_min.y),
+                        fmin(left->_min.z, right->_min.z));
+            _max = Vec3(fmax(left->_max.x, right->_max.x),
+                        fmax(left->_max.y, right->_max.y),
+                        fmax(left->_max.z, right->_max.z));
+            this->left = left;
+            this->right = right;
+            this->axis = axis;
+            this->type = Type::NOLEAF;
+        }
+
+        AABB(Sphere* sp){
+            type = Type::SPHERE;
+            this->sp = sp;
+            float r = sp->radius;
+            Vec3 pos = sp->position;
+            _min = pos - Vec3(r, r, r);
+            _max = pos + Vec3(r, r, r);
+        }
+
+        AABB(Triangle* tr){
+            type = Type::TRIANGLE;
+            this->tr = tr;
+            Vec3 v1 = tr->v1;
+            Vec3 v2 = tr->v2;
+            Vec3 v3 = tr->v3;
+            _min = Vec3(fmin(v1.x, fmin(v2.x, v3.x)),
+                        fmin(v1.y, fmin(v2.y, v3.y)),
+                        fmin(v1.z, fmin(v2.z, v3.z)));
+            _max = Vec3(fmax(v1.x, fmax(v2.x, v3.x)),
+                        fmax(v1.y, fmax(v2.y, v3.y)),
+                        fmax(v1.z, fmax(v2.z, v3.z)));
+            padFlat();
+        }   
+
+        AABB(const PlaneRecord* pl){  //平面的求交记录由BVH统一存放, 这里只引用
+            type = Type::PLANE;
+            this->pl = pl;
+            Vec3 p = pl->position;
+            Vec3 p2 = p + pl->u;
+            Vec3 p3 = p + pl->v;
+            Vec3 p4 = p + pl->u + pl->v;
+            _min = glm::min(glm::min(p, p2), glm::min(p3, p4));
+            _max = glm::max(glm::max(p, p2), glm::max(p3, p4));
+            padFlat();
+        }
+
+        AABB(Instance* in, const Vec3& min, const Vec3& max){  //实例的包围盒由它引用的底层BVH变换到世界空间得到
+            type = Type::INSTANCE;
+            this->in = in;
+            _min = min;
+            _max = max;
+        }
+
+        AABB(const MeshTriangle* mt){  //mesh的三角形由BVH统一存放, 这里只引用
+            type = Type::MESH;
+            this->mt = mt;
+            _min = glm::min(mt->v0, glm::min(mt->v1, mt->v2));
+            _max = glm::max(mt->v0, glm::max(mt->v1, mt->v2));
+            padFlat();
+        }
+    };
+    SHARE(AABB);
+}
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,250 @@
+#pragma once
+#ifndef __ACCEL_BVH_HPP__
+#define __ACCEL_BVH_HPP__
+
+#include "scene/Scene.hpp"
+#include "accel/Ray.hpp"
+#include "accel/HitRecord.hpp"
+#include "geometry/vec.hpp"
+#include "accel/AABB.hpp"
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <cmath>
+#include <functional>
+#include <chrono>
+#include <atomic>
+namespace Accel
+{
+    using namespace NRenderer;
+    using namespace std;
+
+    struct Instance;
+
+    // SoA块的宽度: 有AVX时8个图元一块, 否则4个一块
+#if defined(__AVX__)
+    constexpr int PRIMITIVE_BLOCK_SIZE = 8;
+#else
+    constexpr int PRIMITIVE_BLOCK_SIZE = 4;
+#endif
+
+    // 叶结点中连续的三角形按分量存放(SoA), 用一组SIMD指令同时做水密求交
+    // v[顶点][坐标轴]为一行, 光线的坐标轴置换只需在每个块上选一次行, 不必逐个三角形重排
+    struct alignas(32) TriangleBlock
+    {
+        float v[3][3][PRIMITIVE_BLOCK_SIZE];
+        int32_t primitive[PRIMITIVE_BLOCK_SIZE];    //对应的图元在primitives中的下标
+        int32_t count;                              //有效的三角形数目, 空位的三个顶点重合, 不会与任何光线相交
+    };
+
+    // 叶结点中连续的球, 同样按分量存放
+    struct alignas(32) SphereBlock
+    {
+        float cx[PRIMITIVE_BLOCK_SIZE], cy[PRIMITIVE_BLOCK_SIZE], cz[PRIMITIVE_BLOCK_SIZE];
+        float r2[PRIMITIVE_BLOCK_SIZE];             //半径的平方, 空位为-1, 不会与任何光线相交
+        int32_t primitive[PRIMITIVE_BLOCK_SIZE];
+        int32_t count;
+    };
+
+    // 叶结点引用的图元
+    struct BVHPrimitive
+    {
+        AABB::Type type;
+        int block = -1;     //以该图元开始的SoA块在triangleBlocks/sphereBlocks中的下标, -1表示单独求交
+        union
+        {
+            Sphere* sp;
+            Triangle* tr;
+            const PlaneRecord* pl;
+            Instance* in;
+            const MeshTriangle* mt;
+        };
+    };
+
+    // 展开后的BVH节点, 按深度优先顺序连续存放, 左孩子紧跟在父节点之后
+    struct LinearBVHNode
+    {
+        Vec3 _min;
+        union
+        {
+            int primitiveOffset;    //叶结点: 第一个图元在primitives中的下标
+            int secondChildOffset;  //内部节点: 右孩子在nodes中的下标
+        };
+        Vec3 _max;
+        uint16_t nPrimitives;       //叶结点中的图元数目, 0表示内部节点
+        uint8_t axis;               //内部节点的划分轴
+        uint8_t pad;
+    };
+    static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode should be 32 bytes");
+
+    // 构建时使用的包围盒, 同时记录包含的图元数目
+    struct BuildBounds
+    {
+        Vec3 _min = Vec3(FLOAT_INF, FLOAT_INF, FLOAT_INF);
+        Vec3 _max = Vec3(-FLOAT_INF, -FLOAT_INF, -FLOAT_INF);
+        int count = 0;
+
+        void expand(const Vec3& min, const Vec3& max){
+            _min = glm::min(_min, min);
+            _max = glm::max(_max, max);
+        }
+        void merge(const BuildBounds& other){
+            expand(other._min, other._max);
+            count += other.count;
+        }
+        float surfaceArea() const {
+            Vec3 d = _max - _min;
+            return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+        }
+    };
+
+    class BVHTree{
+
+    public:
+        using SplitMethod = RenderOption::BVHSplitMethod;
+
+        constexpr static int SAH_BINS = 16;                 //每个轴上的bin数目
+        constexpr static float SAH_TRAVERSAL_COST = 0.125f; //遍历一个内部节点的相对开销
+        constexpr static float SAH_INTERSECT_COST = 1.f;    //与一个图元求交的相对开销
+        constexpr static float SAH_BLOCK_COST = 1.5f;       //与一个三角形或球的SoA块求交的相对开销
+        constexpr static int STACK_SIZE = 128;              //遍历时显式栈的大小, 即树的最大深度
+        constexpr static int MAX_SPLIT_DEPTH = 64;          //递归深度达到该值后按图元数对半划分, 剩余的深度不超过log2(图元数)
+        constexpr static int MAX_LEAF_SIZE = 64;            //叶结点图元数的上限
+        constexpr static int PARALLEL_RANGE = 1 << 14;      //图元数超过该值时, 包围盒计算/分桶/划分分块并行
+        constexpr static int PARALLEL_TASK = 1 << 12;       //图元数超过该值时, 左子树作为独立任务构建
+        constexpr static int MORTON_BITS_LARGE = 1 << 20;   //图元数超过该值时使用63位Morton码, 否则使用30位
+        constexpr static int TREELET_LEAVES = 7;            //treelet的叶结点数
+        constexpr static int TREELET_MIN_PRIMITIVES = 16;   //子树图元数不少于该值时才做treelet重构
+        constexpr static float REFIT_DEGRADATION = 1.3f;    //重新拟合后SAH开销超过构建时的该倍数, 则完整重建
+        constexpr static int SBVH_BINS = 32;                //空间划分每个轴上的bin数目
+        constexpr static float SBVH_ALPHA = 1e-5f;          //物体划分两侧的重叠面积超过根节点面积的该比例时, 才尝试空间划分
+        constexpr static float SBVH_DUPLICATION_BUDGET = 0.3f;  //空间划分最多新增的引用数, 相对于图元数
+
+        vector<SharedAABB> aabbs;  
+        SharedAABB root;
+        SharedScene spscene;
+        SplitMethod splitMethod;
+        int maxLeafSize = 1;    //叶结点最多包含的图元数
+        float sahCost = 0.f;    //整棵树的SAH开销, 用于比较不同的划分方式
+        float builtSahCost = 0.f;   //最近一次完整构建时的SAH开销, 重新拟合后据此判断质量是否下降
+        double buildTime = 0.0; //构建耗时(ms)
+        int buildThreads = 1;   //构建使用的线程数
+
+        vector<LinearBVHNode> nodes;        //展开后的节点数组, nodes[0]为根节点
+        vector<BVHPrimitive> primitives;    //按叶结点顺序排列的图元
+        vector<int> leafIndices;            //每个图元对应的叶结点在构建输入中的序号(Mesh的BVH中即三角形序号), 用于磁盘缓存与重新拟合
+        vector<MeshTriangle> meshTriangles; //Mesh三角形的紧凑存储, 按图元顺序排列, MESH类型的图元引用其中的元素
+        vector<PlaneRecord> planeRecords;   //场景中平面的求交记录, PLANE类型的图元引用其中的元素
+        vector<TriangleBlock> triangleBlocks;   //叶结点中连续三角形的SoA块
+        vector<SphereBlock> sphereBlocks;       //叶结点中连续球的SoA块
+
+        //instances不为空时构建两层结构的顶层BVH: 场景中的Mesh节点由instances代替
+        BVHTree(SharedScene spscene, SplitMethod splitMethod, vector<Instance>* instances = nullptr, int maxLeafSize = 1);
+        //单个Mesh在物体空间中的BVH, 即两层结构的底层BVH
+        BVHTree(const Mesh& mesh, SplitMethod splitMethod, int maxLeafSize = 1);
+
+        //场景只有变换发生变化时, 保持拓扑不变, 重新绑定图元并自底向上更新包围盒
+        //场景结构(叶结点的数目与类型)变化时返回false, 需要重新构建
+        bool refit(SharedScene spscene, vector<Instance>* instances = nullptr);
+
+        //节点, 图元, 三角形与SoA块占用的内存(字节)
+        size_t memoryUsage() const;
+
+        void printTree(int index, int depth);
+
+    private:
+        friend class BVHDiskCache;
+
+        // 分桶SAH找到的最优物体划分
+        struct ObjectSplit
+        {
+            int axis = -1;          //-1表示所有中心点重合, 无法划分
+            int bin = -1;           //bin编号<=bin的放在左边
+            float cost = FLOAT_INF; //N_l * S_l + N_r * S_r
+            float cmin = 0.f;       //划分轴上中心点的最小值
+            float scale = 0.f;      //SAH_BINS / 划分轴上中心点的范围
+            BuildBounds left;
+            BuildBounds right;
+
+            bool isLeft(const AABB& a) const {
+                return std::min(SAH_BINS - 1, int((a.centroid()[axis] - cmin) * scale)) <= bin;
+            }
+        };
+
+        // 分桶找到的最优空间划分: 以axis轴上的position为平面, 跨越平面的引用裁剪后放到两侧
+        struct SpatialSplit
+        {
+            int axis = -1;
+            float position = 0.f;
+            float cost = FLOAT_INF;
+            BuildBounds left;       //count为左侧的引用数
+            BuildBounds right;
+        };
+        BVHTree() = default;
+
+        int taskDepth = 0;      //递归深度小于该值的划分, 左右子树并行构建
+        vector<uint64_t> mortonCodes;   //LBVH构建时, 与排序后的aabbs一一对应的Morton码
+        float sbvhRootArea = 0.f;           //SBVH构建时根节点的表面积
+        int sbvhBudget = 0;                 //SBVH构建时允许新增的引用数
+        atomic<int> sbvhReferences = 0;     //SBVH构建时已经新增的引用数
+        atomic<int> sbvhSpatialSplits = 0;  //SBVH构建时采用空间划分的节点数
+        vector<MeshTriangle> buildTriangles;    //构建时按输入顺序创建的Mesh三角形
+
+        void initThreads();
+        //按场景节点的顺序为每个图元(或实例)创建叶结点包围盒, 并记录它在aabbs中的序号
+        void collectLeaves(const SharedScene& spscene, vector<Instance>* instances);
+        //为mesh的每个三角形创建叶结点包围盒, 三角形追加到buildTriangles中
+        //调用前buildTriangles需预留足够的容量, 保证已创建的包围盒中的指针不失效
+        void addMesh(const Mesh& mesh);
+        //由aabbs构建整棵树并展开, begin为开始构建的时间
+        void build(chrono::steady_clock::time_point begin);
+        SharedAABB build_BVH(vector<SharedAABB>& aabbs, int start, int end, int depth); //[start, end)
+        SharedAABB build_BVH_SAH(vector<SharedAABB>& aabbs, int start, int end, int depth);
+        ObjectSplit findObjectSplit(const vector<SharedAABB>& aabbs, int start, int end);
+        //SBVH: 每个节点持有自己的引用数组, 空间划分后两侧的引用数之和可能大于父节点
+        SharedAABB build_SBVH(vector<SharedAABB>& refs, int depth);
+        SpatialSplit findSpatialSplit(const vector<SharedAABB>& refs, const BuildBounds& bounds);
+        //按空间划分把refs分到left与right两侧, 返回新增的引用数
+        int splitReferences(const vector<SharedAABB>& refs, const SpatialSplit& split, vector<SharedAABB>& left, vector<SharedAABB>& right);
+        SharedAABB build_LBVH(vector<SharedAABB>& aabbs, int start, int end, int depth);
+        SharedAABB buildChildren(vector<SharedAABB>& aabbs, int start, int midIndex, int end, int depth, int axis);
+        //按包围盒中心点在最长轴上的中位数划分[start, end), 返回分界位置, 划分轴写入axis
+        int medianSplit(vector<SharedAABB>& aabbs, int start, int end, int& axis);
+
+        //计算包围盒中心点的Morton码, 并按Morton码对aabbs并行基数排序
+        void sortMorton(vector<SharedAABB>& aabbs);
+        //自底向上对每个子树做treelet重构: 用动态规划找出TREELET_LEAVES个叶结点之间SAH开销最小的拓扑
+        SharedAABB optimizeTreelets(SharedAABB node, int depth, int& count);
+        //重构后的子树高度使node的叶结点深度达到STACK_SIZE时, 保留原拓扑
+        SharedAABB restructureTreelet(const SharedAABB& node, int depth);
+
+        //SAH开销: 内部节点的遍历开销与叶结点的求交开销, 按表面积加权求和, 子树中三角形, 球与其他图元的数目写入count
+        //图元数不超过maxLeafSize且作为一个叶结点开销更低的子树标记为合并(leafSize), 展开时成为一个多图元的叶结点
+        float computeSAHCost(const SharedAABB& node, array<int, 3>& count);
+        //叶结点中n个连续的三角形(或球)的求交开销: 每PRIMITIVE_BLOCK_SIZE个一块, 剩下单独一个时逐个求交
+        static float blockCost(int n);
+        //展开后的树的SAH开销, 已按根节点的表面积归一化
+        float flatSAHCost() const;
+        //将指针形式的树按深度优先顺序展开到nodes中, 返回该节点的下标
+        int flatten(const SharedAABB& node, int depth);
+        //收集合并的子树中的图元, SBVH复制的引用只保留一个
+        void collectSubtree(const SharedAABB& node, vector<SharedAABB>& leaves) const;
+        //把MESH图元引用的三角形按图元顺序拷贝到meshTriangles, 并释放buildTriangles
+        void compactTriangles();
+        //按叶结点中连续的三角形与球生成SoA块, 构建, 从磁盘载入与重新拟合之后调用
+        void buildBlocks();
+
+        //将[start, end)分成若干块, 在多个线程上分别执行f(chunk, chunkStart, chunkEnd), 返回块数
+        int parallelChunks(int start, int end, const function<void(int, int, int)>& f);
+        //计算[start, end)中包围盒(centroid为true时为中心点)的整体范围
+        BuildBounds reduceBounds(const vector<SharedAABB>& aabbs, int start, int end, bool centroid);
+        //按pred划分[start, end), 满足pred的放在左边, 返回分界位置
+        int partition(vector<SharedAABB>& aabbs, int start, int end, const function<bool(const SharedAABB&)>& pred);
+    };
+    SHARE(BVHTree);
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+#ifndef __ACCEL_BVH_DISK_CACHE_HPP__
+#define __ACCEL_BVH_DISK_CACHE_HPP__
+
+#include "accel/BVH.hpp"
+#include <string>
+
+namespace Accel
+{
+    using namespace NRenderer;
+    using namespace std;
+
+    // 把展开后的Mesh BVH写入缓存目录, 以几何哈希与构建设置为键
+    // 文件内容为文件头, 节点数组, 以及每个图元对应的三角形序号; 载入时内存映射文件, 直接拷贝节点数组, 不再重新构建
+    class BVHDiskCache
+    {
+    public:
+        BVHDiskCache(const string& directory = "bvh_cache");
+
+        //载入key对应的BVH, 文件不存在或与mesh不匹配时返回nullptr
+        SharedBVHTree load(uint64_t key, const Mesh& mesh, BVHTree::SplitMethod splitMethod);
+        //写入失败时只记录日志, 不影响渲染
+        void save(uint64_t key, const BVHTree& bvh);
+
+    private:
+        string directory;
+
+        string path(uint64_t key) const;
+    };
+}
+
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+#ifndef __ACCEL_PLANAR_RECORD_HPP__
+#define __ACCEL_PLANAR_RECORD_HPP__
+
+#include "scene/Scene.hpp"
+#include "geometry/vec.hpp"
+
+namespace Accel
+{
+    using namespace NRenderer;
+    using namespace std;
+
+    //以position为原点, u, v为两条边的平行四边形上, 把点变换到局部坐标(a, b)的逆基
+    //即矩阵[u, v, u x v]的逆矩阵的前两行, 点在平行四边形内当且仅当a, b都在[0, 1]内
+    inline void planarInverseBasis(const Vec3& u, const Vec3& v, Vec3& invU, Vec3& invV) {
+        Vec3 w = glm::cross(u, v);
+        float det = glm::dot(w, w);
+        invU = glm::cross(v, w) / det;
+        invV = glm::cross(w, u) / det;
+    }
+
+    // 场景准备时由Plane转换得到的求交记录, 平面方程与逆基只计算一次
+    struct PlaneRecord
+    {
+        Vec3 position;
+        Vec3 u;
+        Vec3 v;
+        Vec3 normal;        //Plane中给出的法线归一化后的单位法线, 即交点的法线
+        float offset;       //平面方程dot(normal, x) = offset
+        Vec3 invU;
+        Vec3 invV;
+        Handle material;
+    };
+
+    inline PlaneRecord makePlaneRecord(const Plane& p) {
+        PlaneRecord record;
+        record.position = p.position;
+        record.u = p.u;
+        record.v = p.v;
+        record.normal = glm::normalize(p.normal);
+        record.offset = glm::dot(record.normal, p.position);
+        planarInverseBasis(p.u, p.v, record.invU, record.invV);
+        record.material = p.material;
+        return record;
+    }
+
+    // 场景准备时由AreaLight转换得到的记录, 求交与光源采样共用
+    struct AreaLightRecord
+    {
+        Vec3 radiance;
+        Vec3 position;
+        Vec3 u;
+        Vec3 v;
+        Vec3 normal;        //单位法线, 方向为u x v
+        float offset;       //平面方程dot(normal, x) = offset
+        Vec3 invU;
+        Vec3 invV;
+        float area;         //|u x v|, 均匀采样时的pdf为1 / area
+    };
+
+    inline AreaLightRecord makeAreaLightRecord(const AreaLight& a) {
+        AreaLightRecord record;
+        record.radiance = a.radiance;
+        record.position = a.position;
+        record.u = a.u;
+        record.v = a.v;
+        Vec3 w = glm::cross(a.u, a.v);
+        record.area = glm::length(w);
+        record.normal = w / record.area;
+        record.offset = glm::dot(record.normal, a.position);
+        planarInverseBasis(a.u, a.v, record.invU, record.invV);
+        return record;
+    }
+}
+
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+#ifndef __ACCEL_QUANTIZED_BVH_HPP__
+#define __ACCEL_QUANTIZED_BVH_HPP__
+
+#include "accel/WideBVH.hpp"
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+namespace Accel
+{
+    using namespace NRenderer;
+    using namespace std;
+
+    // 压缩的多叉BVH节点: 孩子的包围盒量化为父节点网格上的8位坐标
+    // 网格原点为所有孩子包围盒的最小角点, 每个轴的间距为2的整数次幂, 解码时只需一次乘加
+    template<int W>
+    struct alignas(16) QuantizedBVHNode
+    {
+        Vec3 origin;            //网格原点
+        int8_t exponent[3];     //每个轴的网格间距为2^exponent
+        uint8_t nChildren;      //有效孩子数目
+        uint8_t qminX[W];       //孩子包围盒的量化坐标, 向外取整, 解码后的包围盒总是包含原包围盒
+        uint8_t qminY[W];
+        uint8_t qminZ[W];
+        uint8_t qmaxX[W];       //空位的min为255, max为0, 不会与任何光线相交
+        uint8_t qmaxY[W];
+        uint8_t qmaxZ[W];
+        int32_t child[W];       //内部孩子: 在nodes中的下标; 叶孩子: 第一个图元在primitives中的下标
+        uint16_t count[W];      //叶孩子的图元数目, 0表示内部孩子
+    };
+
+    // 由W叉BVH量化得到的压缩BVH, 拓扑与W叉BVH相同, 图元数组与二叉树共用
+    template<int W>
+    class QuantizedBVH
+    {
+    public:
+        constexpr static int WIDTH = W;
+        constexpr static int STACK_SIZE = WideBVH<W>::STACK_SIZE;
+
+        SharedBVHTree binary;
+        vector<QuantizedBVHNode<W>> nodes;  //nodes[0]为根节点
+        double buildTime = 0.0;             //量化耗时(ms)
+
+        QuantizedBVH(const WideBVH<W>& wide);
+
+        const vector<BVHPrimitive>& primitives() const {
+            return binary->primitives;
+        }
+        //节点数组占用的内存(字节)
+        size_t memoryUsage() const {
+            return nodes.size() * sizeof(QuantizedBVHNode<W>);
+        }
+    };
+    using QuantizedBVH8 = QuantizedBVH<8>;
+    SHARE(QuantizedBVH8);
+
+}
+
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef __ACCEL_RAY_STATS_HPP__
+#define __ACCEL_RAY_STATS_HPP__
+
+#include <atomic>
+#include <cstdint>
+
+namespace Accel::Stats
+{
+    enum class Counter
+    {
+        RAYS,           //最近交点查询的光线数
+        SHADOW_RAYS,    //遮挡查询的光线数
+        NODES,          //BVH节点(包围盒)的求交次数
+        PRIMITIVES,     //图元的求交次数
+        CULLED,         //有序遍历出栈时入口已在最近交点之后, 整棵跳过的子树数
+        PATHS,          //从相机出发的路径数, 与RAYS一起给出平均路径长度
+        COUNT
+    };
+
+    // 每个线程独占的一组计数器, 按缓存行对齐, 多个渲染线程计数时不会争用同一缓存行
+    // 计数器只由所属线程写入, 用relaxed的读和写代替原子加法, 合并时由其他线程读取
+    struct alignas(64) ThreadCounters
+    {
+        std::atomic<int64_t> value[int(Counter::COUNT)] = {};
+    };
+
+    //第一次计数时为当前线程分配一组计数器, 优先复用已结束线程释放的计数器
+    ThreadCounters* registerThread();
+    //线程结束时把计数累加到全局的合计中, 并释放计数器供之后的线程复用
+    void releaseThread(ThreadCounters* counters);
+
+    // 线程结束时自动释放计数器, 每次渲染新建的线程不会让登记的计数器越来越多
+    struct ThreadSlot
+    {
+        ThreadCounters* counters = registerThread();
+        ~ThreadSlot() { releaseThread(counters); }
+    };
+
+    inline ThreadCounters& local() {
+        thread_local ThreadSlot slot;
+        return *slot.counters;
+    }
+
+    //定义NR_ACCEL_NO_STATS时计数编译为空操作
+    inline void add(Counter c, int64_t n = 1) {
+#ifndef NR_ACCEL_NO_STATS
+        auto& v = local().value[int(c)];
+        v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+#endif
+    }
+
+    //合并所有线程的计数
+    int64_t total(Counter c);
+    //所有线程的计数清零, 只应在没有线程计数时调用, 例如渲染开始前或结束后
+    void reset();
+    //通过logger输出合并后的统计
+    void log();
+}
+
+#endif
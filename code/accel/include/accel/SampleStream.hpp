@@ -0,0 +1,189 @@
+#pragma once
+#ifndef __ACCEL_SAMPLE_STREAM_HPP__
+#define __ACCEL_SAMPLE_STREAM_HPP__
+
+#include "geometry/vec.hpp"
+#include "scene/Scene.hpp"
+
+#include <cstdint>
+#include <cmath>
+
+// 各渲染组件共用的随机数与低差异序列, 组件的采样器只保留各自的线程RandomStream
+namespace Accel
+{
+    using NRenderer::Vec2;
+    using SampleMethod = NRenderer::RenderOption::SampleMethod;
+
+    // PCG32(O'Neill 2014): 64位线性同余的状态经过置换后输出32位随机数, 每次取数只有一次乘加与几次移位
+    class PCG32
+    {
+    private:
+        uint64_t state = 0x853c49e6748fea9bULL;
+        uint64_t inc = 0xda3e39cb94b95bdbULL;  //流的编号, 必须为奇数
+    public:
+        constexpr PCG32() = default;
+
+        //不同stream的序列互不相关, 同一stream中initState决定起点
+        void seed(uint64_t initState, uint64_t stream) {
+            state = 0;
+            inc = (stream << 1) | 1;
+            nextUInt();
+            state += initState;
+            nextUInt();
+        }
+
+        uint32_t nextUInt() {
+            uint64_t old = state;
+            state = old * 6364136223846793005ULL + inc;
+            uint32_t xorShifted = uint32_t(((old >> 18) ^ old) >> 27);
+            uint32_t rot = uint32_t(old >> 59);
+            return (xorShifted >> rot) | (xorShifted << ((~rot + 1) & 31));
+        }
+
+        //[0, 1)内均匀分布的浮点数, 只取高24位, 结果不会舍入到1
+        float nextFloat() {
+            return float(nextUInt() >> 8) * (1.f / 16777216.f);
+        }
+    };
+
+    //SplitMix64的混合函数, 把相邻的输入打散成互不相关的64位值
+    inline uint64_t mix64(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    namespace LowDiscrepancy
+    {
+        inline uint32_t reverseBits(uint32_t x) {
+            x = (x << 16) | (x >> 16);
+            x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+            x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+            x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+            x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+            return x;
+        }
+
+        // Owen置乱(Burley 2020): 在位反转后的整数上做Laine-Karras置换, 等价于对每一层二分区间按前缀哈希随机翻转
+        inline uint32_t owenScramble(uint32_t x, uint32_t seed) {
+            x = reverseBits(x);
+            x += seed;
+            x ^= x * 0x6c50b47cu;
+            x ^= x * 0xb82f1e52u;
+            x ^= x * 0xc7afe638u;
+            x ^= x * 0x8d22f6e6u;
+            return reverseBits(x);
+        }
+
+        // Sobol序列的前两维, 第0维是van der Corput序列, 第1维的方向数满足v[i] = v[i-1] ^ (v[i-1] >> 1)
+        // 两维合起来是(0, 2)序列, 任意2的幂个连续点在每种面积相同的二维基本区间中恰好各有一个
+        inline uint32_t sobol(uint32_t index, int dim) {
+            if (dim == 0) return reverseBits(index);
+            uint32_t x = 0;
+            for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1) {
+                if (index & 1) x ^= v;
+            }
+            return x;
+        }
+
+        constexpr int HALTON_DIMS = 32;
+        constexpr uint32_t PRIMES[HALTON_DIMS] = {
+            2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+            59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131
+        };
+
+        inline float radicalInverse(uint32_t index, uint32_t base) {
+            double invBase = 1.0 / base, invBi = invBase, r = 0;
+            while (index) {
+                r += double(index % base) * invBi;
+                index /= base;
+                invBi *= invBase;
+            }
+            return float(r);
+        }
+
+        inline float toFloat(uint32_t x) {
+            return float(x >> 8) * (1.f / 16777216.f);
+        }
+
+        inline float wrap(float x) {
+            x -= std::floor(x);
+            return x < 1.f ? x : 0.f;
+        }
+    }
+
+    // 一个采样所用的随机数流
+    // 每个采样开始时用(像素, 采样序号, 种子)重新设定, 之后镜头, 光源, BSDF等各维度依次取数, 结果只取决于种子
+    // 低差异的方法按二维一组发放: 像素抖动, 镜头, 光源位置, BSDF方向各占一组, 组内两维联合分层
+    class SampleStream
+    {
+    private:
+        PCG32 rng;
+        SampleMethod method = SampleMethod::RANDOM;
+        uint32_t x = 0, y = 0;
+        uint32_t index = 0;
+        uint32_t seed = 0;
+        uint32_t dim = 0;           //下一个要取的维度
+        uint64_t pixelHash = 0;
+
+        uint32_t hash(uint32_t d, uint64_t key) const {
+            return uint32_t(mix64(key ^ (uint64_t(d) * 0x9e3779b97f4a7c15ULL)));
+        }
+
+        float sample(uint32_t d) {
+            using namespace LowDiscrepancy;
+            switch (method) {
+            case SampleMethod::SOBOL: {
+                // 每组两维用各自置乱过的采样序号与Owen置乱, 组与组之间不相关(shuffled Sobol)
+                uint32_t pair = d >> 1;
+                uint32_t i = owenScramble(index, hash(pair, pixelHash));
+                return toFloat(owenScramble(sobol(i, d & 1), hash(d, pixelHash ^ 0x5bd1e995u)));
+            }
+            case SampleMethod::HALTON: {
+                // 超出素数表的维度退化为随机数; 每个像素对每一维做一次随机平移(Cranley-Patterson)
+                if (d >= HALTON_DIMS) return rng.nextFloat();
+                return wrap(radicalInverse(index, PRIMES[d]) + toFloat(hash(d, pixelHash)));
+            }
+            case SampleMethod::BLUE_NOISE: {
+                // 所有像素共用同一组置乱的Sobol点, 只按R2抖动图(Roberts 2018)平移
+                // 相邻像素的平移量相差很大, 误差在屏幕上呈蓝噪声分布, 而不是白噪声
+                uint32_t pair = d >> 1;
+                uint64_t global = mix64(seed);
+                uint32_t i = owenScramble(index, hash(pair, global));
+                float v = toFloat(owenScramble(sobol(i, d & 1), hash(d, global ^ 0x5bd1e995u)));
+                float mask = wrap(0.7548776662f * float(x) + 0.5698402909f * float(y));
+                return wrap(v + mask + 0.6180339887f * float(d));
+            }
+            default:
+                return rng.nextFloat();
+            }
+        }
+    public:
+        void begin(uint32_t px, uint32_t py, uint32_t sampleIndex, uint32_t randomSeed, SampleMethod sampleMethod) {
+            method = sampleMethod;
+            x = px;
+            y = py;
+            index = sampleIndex;
+            seed = randomSeed;
+            dim = 0;
+            pixelHash = mix64((uint64_t(py) << 32 | px) ^ mix64(randomSeed));
+            rng.seed(mix64((uint64_t(randomSeed) << 32) | sampleIndex), uint64_t(py) << 32 | px);
+        }
+
+        float nextFloat() {
+            return sample(dim++);
+        }
+
+        //从新的一组取两维, 奇数维之后跳过一维以保持分组对齐
+        Vec2 next2D() {
+            dim = (dim + 1) & ~1u;
+            float u = sample(dim);
+            float v = sample(dim + 1);
+            dim += 2;
+            return { u, v };
+        }
+    };
+}
+
+#endif
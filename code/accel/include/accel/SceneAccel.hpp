@@ -0,0 +1,73 @@
+#pragma once
+#ifndef __ACCEL_SCENE_ACCEL_HPP__
+#define __ACCEL_SCENE_ACCEL_HPP__
+
+#include "scene/Scene.hpp"
+#include "accel/Ray.hpp"
+#include "accel/HitRecord.hpp"
+#include "accel/BVH.hpp"
+#include "accel/WideBVH.hpp"
+#include "accel/QuantizedBVH.hpp"
+#include "accel/TwoLevelBVH.hpp"
+#include "accel/PlanarRecord.hpp"
+#include "accel/RayStats.hpp"
+
+#include <vector>
+
+namespace Accel
+{
+    using namespace NRenderer;
+    using namespace std;
+
+    // 各渲染组件共用的场景加速结构: 按renderOption中的BVH设置构建两层BVH, 提供最近交点与遮挡查询
+    // 构建前球体, 三角形与平面应已变换到世界空间, Mesh保持在物体空间, 由实例记录模型的平移与缩放
+    // 面光源同时转换为求交与采样共用的记录
+    class SceneAccel
+    {
+    public:
+        SceneAccel(SharedScene spScene);
+
+        //(tMin, tMax)内的最近交点, 没有交点时返回nullopt
+        HitRecord closestHit(const Ray& r, float tMin, float tMax);
+        //(tMin, tMax)内是否有任意交点
+        bool occluded(const Ray& r, float tMin, float tMax) const;
+        //count(不超过Intersection::MAX_PACKET_SIZE)条方向相近的光线成包求最近交点, 结果写入hits
+        //光线包总是遍历二叉的顶层与底层BVH, 与bvhLayout无关
+        void closestHitPacket(const Ray* rays, int count, float tMin, float tMax, HitRecord* hits);
+        //成包的遮挡查询, 每条光线有各自的tMax
+        void occludedPacket(const Ray* rays, int count, float tMin, const float* tMax, bool* occluded) const;
+
+        //输出渲染过程中各线程合并后的光线统计, 并清零计数
+        void logStats();
+        //多叉布局下, 用同一组光线分别遍历二叉树与多叉树, 比较每秒求交的光线数, 每条光线访问的节点数与节点占用的内存
+        void logLayoutSpeed(const vector<Ray>& rays);
+        //rays中每相邻packetSize条光线组成一个光线包, 比较逐条遍历与成包遍历二叉BVH时每秒求交的光线数
+        void logPacketSpeed(const vector<Ray>& rays, int packetSize);
+
+        const BVHTree& tlas() const {
+            return *bvhTree;
+        }
+
+        //与scene.areaLightBuffer一一对应
+        const vector<AreaLightRecord>& areaLights() const {
+            return lights;
+        }
+
+    private:
+        SharedScene spScene;
+        Scene& scene;
+
+        SharedBVHTree bvhTree = nullptr;   //顶层BVH, Mesh以实例的形式加入
+        vector<Instance> instances;
+        vector<AreaLightRecord> lights;
+        RenderOption::BVHLayout bvhLayout;
+        SharedWideBVH4 bvh4 = nullptr;  //bvhLayout为BVH4时由bvhTree坍缩得到
+        SharedWideBVH8 bvh8 = nullptr;  //bvhLayout为BVH8时由bvhTree坍缩得到
+        SharedQuantizedBVH8 qbvh8 = nullptr;    //bvhLayout为BVH8_COMPRESSED时由bvhTree坍缩后量化得到
+
+        void buildInstances();
+    };
+    SHARE(SceneAccel);
+}
+
+#endif
@@ -0,0 +1,94 @@
+#pragma once
+#ifndef __ACCEL_TWO_LEVEL_BVH_HPP__
+#define __ACCEL_TWO_LEVEL_BVH_HPP__
+
+#include "accel/BVH.hpp"
+#include "accel/WideBVH.hpp"
+#include "accel/QuantizedBVH.hpp"
+#include "accel/BVHDiskCache.hpp"
+#include <unordered_map>
+#include <mutex>
+
+namespace Accel
+{
+    using namespace NRenderer;
+    using namespace std;
+
+    // 底层BVH: 单个Mesh在物体空间中的BVH, 多叉布局按需由二叉树坍缩得到
+    struct MeshBVH
+    {
+        SharedBVHTree bvh;
+        SharedWideBVH4 bvh4 = nullptr;
+        SharedWideBVH8 bvh8 = nullptr;
+        SharedQuantizedBVH8 qbvh8 = nullptr;
+    };
+    SHARE(MeshBVH);
+
+    // 模型实例: 引用一个底层BVH, 以及物体空间到世界空间的变换(先缩放再平移)
+    struct Instance
+    {
+        SharedMeshBVH blas;
+        Vec3 translation;
+        Vec3 scale;
+        RenderOption::BVHLayout layout;    //遍历底层BVH时使用的布局
+        Vec3 _min;  //世界空间的包围盒
+        Vec3 _max;
+
+        Instance(SharedMeshBVH blas, const Vec3& translation, const Vec3& scale, RenderOption::BVHLayout layout);
+
+        //把世界空间的光线变换到物体空间, 方向不归一化, 因此两个空间中的t相同
+        Ray toObject(const Ray& ray) const {
+            return Ray{(ray.origin - translation) / scale, ray.direction / scale};
+        }
+        //物体空间的法向量变换到世界空间(缩放矩阵的逆转置)
+        Vec3 normalToWorld(const Vec3& normal) const {
+            return glm::normalize(normal / scale);
+        }
+    };
+
+    // 跨多次渲染保留的底层BVH, 以Mesh的几何哈希为键, 并可写入磁盘供之后启动时载入
+    // 只修改模型变换后重新渲染时, 底层BVH直接复用, 只需重建顶层BVH; 几何相同的Mesh共用同一个底层BVH
+    class MeshBVHCache
+    {
+    public:
+        // 底层BVH的来源
+        enum class Source
+        {
+            MEMORY,     // 复用之前渲染中的BVH
+            DISK,       // 从磁盘缓存载入
+            BUILT       // 重新构建
+        };
+        //返回mesh对应的底层BVH; useDisk为true时, 内存中没有的BVH先尝试从磁盘载入, 新构建的BVH写入磁盘
+        SharedMeshBVH get(const Mesh& mesh, const RenderOption& option, Source& source);
+        //丢弃本次渲染没有用到的底层BVH
+        void endFrame();
+
+        //对顶点位置, 索引与材质计算64位哈希
+        static uint64_t hashMesh(const Mesh& mesh);
+
+    private:
+        mutex mtx;
+        BVHDiskCache diskCache;
+        unordered_map<uint64_t, SharedMeshBVH> cache;
+        unordered_map<uint64_t, SharedMeshBVH> used;    //本次渲染用到的底层BVH
+    };
+
+    MeshBVHCache& meshBVHCache();
+
+    // 跨多次渲染保留的顶层BVH
+    // 场景结构不变(只修改了模型或图元的变换)时重新拟合上一次的顶层BVH, 拟合后SAH开销相对构建时上升超过阈值则完整重建
+    class TopLevelBVHCache
+    {
+    public:
+        //返回本次渲染使用的顶层BVH, refitted表示是否由上一次的BVH重新拟合得到
+        SharedBVHTree get(SharedScene spscene, vector<Instance>& instances, const RenderOption& option, bool& refitted);
+
+    private:
+        mutex mtx;
+        SharedBVHTree tlas = nullptr;
+    };
+
+    TopLevelBVHCache& topLevelBVHCache();
+}
+
+#endif
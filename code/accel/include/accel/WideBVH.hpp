@@ -0,0 +1,63 @@
+#pragma once
+#ifndef __ACCEL_WIDE_BVH_HPP__
+#define __ACCEL_WIDE_BVH_HPP__
+
+#include "accel/BVH.hpp"
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+namespace Accel
+{
+    using namespace NRenderer;
+    using namespace std;
+
+    // 多叉BVH节点, 孩子的包围盒按分量连续存放(SoA), 便于用一条SIMD指令同时测试W个包围盒
+    template<int W>
+    struct alignas(32) WideBVHNode
+    {
+        float minX[W];
+        float minY[W];
+        float minZ[W];
+        float maxX[W];
+        float maxY[W];
+        float maxZ[W];
+        int32_t child[W];       //内部孩子: 在nodes中的下标; 叶孩子: 第一个图元在primitives中的下标
+        uint16_t count[W];      //叶孩子的图元数目, 0表示内部孩子
+        int32_t nChildren;      //有效孩子数目, 空位的包围盒为空盒(min = INF, max = -INF), 不会与任何光线相交
+    };
+
+    // 由二叉BVH坍缩得到的W叉BVH, 图元数组与二叉树共用
+    template<int W>
+    class WideBVH
+    {
+    public:
+        constexpr static int WIDTH = W;
+        constexpr static int STACK_SIZE = BVHTree::STACK_SIZE * (W - 1); //每层最多有W-1个孩子留在栈中
+
+        SharedBVHTree binary;
+        vector<WideBVHNode<W>> nodes;   //nodes[0]为根节点
+        double buildTime = 0.0;         //坍缩耗时(ms)
+
+        WideBVH(SharedBVHTree binary);
+
+        const vector<BVHPrimitive>& primitives() const {
+            return binary->primitives;
+        }
+        //节点数组占用的内存(字节)
+        size_t memoryUsage() const {
+            return nodes.size() * sizeof(WideBVHNode<W>);
+        }
+
+    private:
+        //把二叉树中以index为根的子树坍缩为一个W叉节点, 返回该节点在nodes中的下标
+        int collapse(int index);
+    };
+    using WideBVH4 = WideBVH<4>;
+    using WideBVH8 = WideBVH<8>;
+    SHARE(WideBVH4);
+    SHARE(WideBVH8);
+
+}
+
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef __ACCEL_INTERSECTIONS_HPP__
+#define __ACCEL_INTERSECTIONS_HPP__
+
+#include "accel/HitRecord.hpp"
+#include "accel/Ray.hpp"
+#include "scene/Scene.hpp"
+#include "accel/AABB.hpp"
+#include "accel/BVH.hpp"
+#include "accel/WideBVH.hpp"
+#include "accel/QuantizedBVH.hpp"
+#include "accel/TwoLevelBVH.hpp"
+#include "accel/RayStats.hpp"
+
+namespace Accel
+{
+    namespace Intersection
+    {
+        // 三角形使用水密求交, 光线经过相邻三角形的共享边时不会漏过
+        HitRecord xTriangle(const Ray& ray, const Triangle& t, float tMin = 0.f, float tMax = FLOAT_INF);
+        HitRecord xMeshTriangle(const Ray& ray, const MeshTriangle& t, float tMin = 0.f, float tMax = FLOAT_INF);
+        HitRecord xSphere(const Ray& ray, const Sphere& s, float tMin = 0.f, float tMax = FLOAT_INF);
+        HitRecord xPlane(const Ray& ray, const PlaneRecord& p, float tMin = 0.f, float tMax = FLOAT_INF);
+        HitRecord xAreaLight(const Ray& ray, const AreaLightRecord& a, float tMin = 0.f, float tMax = FLOAT_INF);
+        //光线变换到物体空间后遍历实例的底层BVH, 交点与法向量再变换回世界空间
+        HitRecord xInstance(const Ray& ray, const Instance& in, float tMin = 0.f, float tMax = FLOAT_INF);
+        HitRecord xPrimitive(const Ray& ray, const BVHPrimitive& p, float tMin = 0.f, float tMax = FLOAT_INF);
+        HitRecord xBVH(const Ray& ray, const BVHTree& bvh, float tMin = 0.f, float tMax = FLOAT_INF);
+        // 多叉BVH: 每访问一个节点, 用SIMD同时测试它所有孩子的包围盒
+        HitRecord xBVH(const Ray& ray, const WideBVH4& bvh, float tMin = 0.f, float tMax = FLOAT_INF);
+        HitRecord xBVH(const Ray& ray, const WideBVH8& bvh, float tMin = 0.f, float tMax = FLOAT_INF);
+        // 压缩的8叉BVH: 孩子包围盒为8位量化坐标, 节点内存约为未压缩时的一半
+        HitRecord xBVH(const Ray& ray, const QuantizedBVH8& bvh, float tMin = 0.f, float tMax = FLOAT_INF);
+
+        // 遮挡查询: 只判断(tMin, tMax)内是否有交点, 找到任意一个即返回, 不构造HitRecord
+        bool occTriangle(const Ray& ray, const Triangle& t, float tMin, float tMax);
+        bool occMeshTriangle(const Ray& ray, const MeshTriangle& t, float tMin, float tMax);
+        bool occSphere(const Ray& ray, const Sphere& s, float tMin, float tMax);
+        bool occPlane(const Ray& ray, const PlaneRecord& p, float tMin, float tMax);
+        bool occInstance(const Ray& ray, const Instance& in, float tMin, float tMax);
+        bool occPrimitive(const Ray& ray, const BVHPrimitive& p, float tMin, float tMax);
+        bool occluded(const Ray& ray, const BVHTree& bvh, float tMin, float tMax);
+        bool occluded(const Ray& ray, const WideBVH4& bvh, float tMin, float tMax);
+        bool occluded(const Ray& ray, const WideBVH8& bvh, float tMin, float tMax);
+        bool occluded(const Ray& ray, const QuantizedBVH8& bvh, float tMin, float tMax);
+
+        // 光线包: count(不超过MAX_PACKET_SIZE)条方向相近的光线一起遍历二叉BVH, 每个节点只取一次,
+        // 用SIMD一次测试4条光线; 所有光线方向同号时先用区间算术整包剔除节点, 光线发散时只让仍相交的光线继续向下
+        constexpr int MAX_PACKET_SIZE = 16;
+        void xBVHPacket(const Ray* rays, int count, const BVHTree& bvh, float tMin, float tMax, HitRecord* hits);
+        //每条光线有各自的tMax, 例如射向光源不同采样点的阴影光线
+        void occludedPacket(const Ray* rays, int count, const BVHTree& bvh, float tMin, const float* tMax, bool* occluded);
+
+        // 图元与BVH节点的求交次数, 由Stats合并所有线程的计数得到
+        int64_t getIntersectionCount();
+        int64_t getAABBCount();
+        void resetIntersectionCount(); // 将所有统计重置为0
+    
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,1001 @@
+#include "accel/BVH.hpp"
+#include "accel/TwoLevelBVH.hpp"
+#include "server/Server.hpp"
+
+#include <chrono>
+#include <future>
+#include <thread>
+#include <bit>
+#include <algorithm>
+
+namespace Accel
+{
+    BVHTree::BVHTree(SharedScene spscene, SplitMethod splitMethod, vector<Instance>* instances, int maxLeafSize){
+        auto begin = chrono::steady_clock::now();
+        this->spscene = spscene;
+        this->splitMethod = splitMethod;
+        this->maxLeafSize = std::clamp(maxLeafSize, 1, MAX_LEAF_SIZE);
+        initThreads();
+
+        collectLeaves(spscene, instances);
+        build(begin);
+    }
+
+    BVHTree::BVHTree(const Mesh& mesh, SplitMethod splitMethod, int maxLeafSize){
+        auto begin = chrono::steady_clock::now();
+        this->splitMethod = splitMethod;
+        this->maxLeafSize = std::clamp(maxLeafSize, 1, MAX_LEAF_SIZE);
+        initThreads();
+        buildTriangles.reserve(mesh.positionIndices.size() / 3);
+        addMesh(mesh);
+        for(int i = 0; i < int(aabbs.size()); i++) aabbs[i]->index = i;
+        build(begin);
+    }
+
+    void BVHTree::initThreads(){
+        buildThreads = std::max(1, int(thread::hardware_concurrency()));
+        while((1 << taskDepth) < buildThreads) taskDepth++;
+        taskDepth += 2; //任务数略多于线程数, 以平衡左右子树大小不均的情况
+    }
+
+    void BVHTree::collectLeaves(const SharedScene& spscene, vector<Instance>* instances){
+        size_t meshTriangleNum = 0;
+        size_t planeNum = 0;
+        for(auto& node: spscene->nodes){
+            if(node.type == Node::Type::MESH && instances == nullptr) meshTriangleNum += spscene->meshBuffer[node.entity].positionIndices.size() / 3;
+            else if(node.type == Node::Type::PLANE) planeNum++;
+        }
+        buildTriangles.clear();
+        buildTriangles.reserve(meshTriangleNum);
+        //平面在此转换为求交记录, 预留容量保证包围盒中的指针不失效
+        planeRecords.clear();
+        planeRecords.reserve(planeNum);
+        for(auto& node: spscene->nodes){
+            if(node.type == Node::Type::SPHERE){
+                 aabbs.push_back(make_shared<AABB>(&(spscene->sphereBuffer[node.entity])));
+            }
+            else if(node.type == Node::Type::TRIANGLE){
+                aabbs.push_back(make_shared<AABB>(&(spscene->triangleBuffer[node.entity])));
+            }
+            else if(node.type == Node::Type::PLANE){
+                planeRecords.push_back(makePlaneRecord(spscene->planeBuffer[node.entity]));
+                aabbs.push_back(make_shared<AABB>(&planeRecords.back()));
+            }
+            else if(node.type == Node::Type::MESH){
+                if(instances != nullptr) continue;  //两层结构中Mesh以实例的形式加入
+                addMesh(spscene->meshBuffer[node.entity]);
+            }
+            else{
+                throw runtime_error("Unknown Node Type");
+            }
+        }
+        if(instances != nullptr){
+            for(auto& instance: *instances){
+                aabbs.push_back(make_shared<AABB>(&instance, instance._min, instance._max));
+            }
+        }
+        for(int i = 0; i < int(aabbs.size()); i++) aabbs[i]->index = i;
+    }
+
+    void BVHTree::addMesh(const Mesh& mesh){
+        int offset = int(aabbs.size());
+        int base = int(buildTriangles.size());
+        int triangles = int(mesh.positionIndices.size() / 3);
+        aabbs.resize(offset + triangles);
+        buildTriangles.resize(base + triangles);
+        parallelChunks(0, triangles, [&](int, int chunkStart, int chunkEnd){
+            for(int i = chunkStart; i < chunkEnd; i++){  //每三个为一个三角形
+                buildTriangles[base + i] = makeMeshTriangle(mesh, i);
+                aabbs[offset + i] = make_shared<AABB>(&buildTriangles[base + i]);
+            }
+        });
+    }
+
+    void BVHTree::build(chrono::steady_clock::time_point begin){
+        if(aabbs.empty()) return;
+        if(splitMethod == SplitMethod::SAH){
+            root = build_BVH_SAH(aabbs, 0, aabbs.size(), 0);
+        }
+        else if(splitMethod == SplitMethod::LBVH || splitMethod == SplitMethod::LBVH_TREELET){
+            sortMorton(aabbs);
+            root = build_LBVH(aabbs, 0, aabbs.size(), 0);
+            mortonCodes.clear();
+            mortonCodes.shrink_to_fit();
+            if(splitMethod == SplitMethod::LBVH_TREELET){
+                int count;
+                root = optimizeTreelets(root, 0, count);
+            }
+        }
+        else if(splitMethod == SplitMethod::SBVH){
+            sbvhRootArea = reduceBounds(aabbs, 0, aabbs.size(), false).surfaceArea();
+            sbvhBudget = int(aabbs.size() * SBVH_DUPLICATION_BUDGET);
+            vector<SharedAABB> refs = aabbs;
+            root = build_SBVH(refs, 0);
+            getServer().logger.log("SBVH: " + to_string(sbvhSpatialSplits.load()) + " spatial splits, "
+                + to_string(sbvhReferences.load()) + " duplicated references");
+        }
+        else{
+            root = build_BVH(aabbs, 0, aabbs.size(), 0);
+        }
+        array<int, 3> count;
+        sahCost = computeSAHCost(root, count) / root->surfaceArea();
+        builtSahCost = sahCost;
+
+        nodes.reserve(2 * aabbs.size() - 1);
+        primitives.reserve(aabbs.size());
+        leafIndices.reserve(aabbs.size());
+        flatten(root, 0);
+        compactTriangles();
+        buildBlocks();
+        //展开后不再需要指针形式的树
+        root = nullptr;
+        size_t primitiveNum = aabbs.size();
+        aabbs.clear();
+        aabbs.shrink_to_fit();
+
+        buildTime = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+        getServer().logger.log("BVH built in " + to_string(buildTime) + " ms: "
+            + to_string(primitiveNum) + " primitives, " + to_string(nodes.size()) + " nodes, "
+            + to_string(memoryUsage() / 1024) + " KB, " + to_string(buildThreads) + " threads");
+    }
+
+    int BVHTree::parallelChunks(int start, int end, const function<void(int, int, int)>& f){
+        int n = end - start;
+        int chunks = n >= PARALLEL_RANGE ? std::min(buildThreads, n / (PARALLEL_RANGE / 4)) : 1;
+        if(chunks <= 1){
+            f(0, start, end);
+            return 1;
+        }
+        vector<future<void>> tasks;
+        int chunkSize = (n + chunks - 1) / chunks;
+        for(int c = 1; c < chunks; c++){
+            int chunkStart = std::min(end, start + c * chunkSize);
+            int chunkEnd = std::min(end, chunkStart + chunkSize);
+            tasks.push_back(async(launch::async, f, c, chunkStart, chunkEnd));
+        }
+        f(0, start, std::min(end, start + chunkSize));  //第一块在当前线程上执行
+        for(auto& t : tasks) t.get();
+        return chunks;
+    }
+
+    BuildBounds BVHTree::reduceBounds(const vector<SharedAABB>& aabbs, int start, int end, bool centroid){
+        vector<BuildBounds> partial(std::max(1, buildThreads));
+        int chunks = parallelChunks(start, end, [&](int chunk, int chunkStart, int chunkEnd){
+            BuildBounds bounds;
+            for(int i = chunkStart; i < chunkEnd; i++){
+                if(centroid){
+                    Vec3 c = aabbs[i]->centroid();
+                    bounds.expand(c, c);
+                }
+                else{
+                    bounds.expand(aabbs[i]->_min, aabbs[i]->_max);
+                }
+            }
+            bounds.count = chunkEnd - chunkStart;
+            partial[chunk] = bounds;
+        });
+        for(int c = 1; c < chunks; c++){
+            partial[0].merge(partial[c]);
+        }
+        return partial[0];
+    }
+
+    int BVHTree::partition(vector<SharedAABB>& aabbs, int start, int end, const function<bool(const SharedAABB&)>& pred){
+        if(end - start < PARALLEL_RANGE){
+            auto mid = std::partition(aabbs.begin() + start, aabbs.begin() + end, pred);
+            return int(mid - aabbs.begin());
+        }
+        //每块各自划分, 再把所有块的左半部分和右半部分依次拼接
+        vector<int> chunkStarts(buildThreads + 1), chunkMids(buildThreads);
+        int chunks = parallelChunks(start, end, [&](int chunk, int chunkStart, int chunkEnd){
+            auto mid = std::partition(aabbs.begin() + chunkStart, aabbs.begin() + chunkEnd, pred);
+            chunkStarts[chunk] = chunkStart;
+            chunkMids[chunk] = int(mid - aabbs.begin());
+        });
+        chunkStarts[chunks] = end;
+        vector<SharedAABB> merged;
+        merged.reserve(end - start);
+        for(int c = 0; c < chunks; c++){
+            for(int i = chunkStarts[c]; i < chunkMids[c]; i++) merged.push_back(std::move(aabbs[i]));
+        }
+        int midIndex = start + int(merged.size());
+        for(int c = 0; c < chunks; c++){
+            for(int i = chunkMids[c]; i < chunkStarts[c + 1]; i++) merged.push_back(std::move(aabbs[i]));
+        }
+        std::move(merged.begin(), merged.end(), aabbs.begin() + start);
+        return midIndex;
+    }
+
+    //较大的子树在递归较浅时作为独立任务构建, 当前线程继续构建右子树
+    SharedAABB BVHTree::buildChildren(vector<SharedAABB>& aabbs, int start, int midIndex, int end, int depth, int axis){
+        auto build = [&](int s, int e){
+            if(splitMethod == SplitMethod::SAH) return build_BVH_SAH(aabbs, s, e, depth + 1);
+            if(splitMethod == SplitMethod::MIDPOINT) return build_BVH(aabbs, s, e, depth + 1);
+            return build_LBVH(aabbs, s, e, depth + 1);
+        };
+        SharedAABB left, right;
+        if(depth < taskDepth && end - start >= PARALLEL_TASK){
+            auto leftTask = async(launch::async, build, start, midIndex);
+            right = build(midIndex, end);
+            left = leftTask.get();
+        }
+        else{
+            left = build(start, midIndex);
+            right = build(midIndex, end);
+        }
+        //return SharedAABB{new AABB(left, right)};
+        return make_shared<AABB>(left, right, axis);
+    }
+
+    int BVHTree::medianSplit(vector<SharedAABB>& aabbs, int start, int end, int& axis){
+        BuildBounds centroidBounds = reduceBounds(aabbs, start, end, true);
+        Vec3 extent = centroidBounds._max - centroidBounds._min;
+        axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        int midIndex = start + (end - start) / 2;
+        nth_element(aabbs.begin() + start, aabbs.begin() + midIndex, aabbs.begin() + end, [&](const SharedAABB& a, const SharedAABB& b){
+            return a->centroid()[axis] < b->centroid()[axis];
+        });
+        return midIndex;
+    }
+
+    SharedAABB BVHTree::build_BVH(vector<SharedAABB>& aabbs, int start, int end, int depth){ //[start, end)
+        if(start == end || start == end - 1){   //leaf node,仅有一个Entity
+            return aabbs[start];
+        }
+        if(depth >= MAX_SPLIT_DEPTH){   //中心点按几何级数分布时每层只分出一个图元, 改为按数量对半分, 避免树过深
+            int axis;
+            int midIndex = medianSplit(aabbs, start, end, axis);
+            return buildChildren(aabbs, start, midIndex, end, depth, axis);
+        }
+        BuildBounds bounds = reduceBounds(aabbs, start, end, false); //计算整体的最紧包围盒
+        Vec3 size = bounds._max - bounds._min; //计算包围盒的长宽高,并找到最长的轴(分布最散的轴)  
+        int axis = 0;
+        if(size.y > size.x) axis = 1;
+        if(size.z > size.y) axis = 2;
+        if(size.z > size.x) axis = 2;
+        float mid = (bounds._min[axis] + bounds._max[axis]) / 2; //计算中点
+        //划分后,midIndex左边的都是小于mid的,右边(>=midIndex)的都是大于mid的AABB
+        int midIndex = partition(aabbs, start, end, [&](const SharedAABB& a){
+            return (a->_min[axis] + a->_max[axis]) / 2 < mid; //在左边/上边/前边
+        });
+        if(midIndex == start || midIndex == end){ //全部在左边/上边/前边或者全部在右边/下边/后边
+            midIndex = start + (end - start) / 2; //取中间的一个
+        }
+        return buildChildren(aabbs, start, midIndex, end, depth, axis);
+    } 
+
+    BVHTree::ObjectSplit BVHTree::findObjectSplit(const vector<SharedAABB>& aabbs, int start, int end){
+        //按包围盒中心点的范围划分bins, 而不是整体包围盒的范围
+        BuildBounds centroidBounds = reduceBounds(aabbs, start, end, true);
+        Vec3 cmin = centroidBounds._min;
+        Vec3 extent = centroidBounds._max - cmin;
+
+        //三个轴同时分桶, 每个线程先统计自己的一块, 再合并
+        using Bins = array<array<BuildBounds, SAH_BINS>, 3>;
+        vector<Bins> partial(std::max(1, buildThreads));
+        int chunks = parallelChunks(start, end, [&](int chunk, int chunkStart, int chunkEnd){
+            Bins& bins = partial[chunk];
+            bins = Bins{};
+            for(int i = chunkStart; i < chunkEnd; i++){
+                Vec3 c = aabbs[i]->centroid();
+                for(int axis = 0; axis < 3; axis++){
+                    if(extent[axis] <= 0.f) continue;
+                    int b = std::min(SAH_BINS - 1, int((c[axis] - cmin[axis]) * (SAH_BINS / extent[axis])));
+                    bins[axis][b].count++;
+                    bins[axis][b].expand(aabbs[i]->_min, aabbs[i]->_max);
+                }
+            }
+        });
+        for(int c = 1; c < chunks; c++){
+            for(int axis = 0; axis < 3; axis++){
+                for(int b = 0; b < SAH_BINS; b++) partial[0][axis][b].merge(partial[c][axis][b]);
+            }
+        }
+
+        ObjectSplit best;
+        for(int axis = 0; axis < 3; axis++){
+            if(extent[axis] <= 0.f) continue;  //该轴上所有中心点重合, 无法划分
+            const auto& bins = partial[0][axis];
+            //从右往左扫描, 记录每个划分位置右侧的包围盒和图元数
+            array<BuildBounds, SAH_BINS - 1> right;
+            BuildBounds acc;
+            for(int b = SAH_BINS - 1; b > 0; b--){
+                acc.merge(bins[b]);
+                right[b - 1] = acc;
+            }
+            //从左往右扫描, 计算每个划分位置的开销 C = N_l * S_l + N_r * S_r
+            acc = BuildBounds{};
+            for(int b = 0; b < SAH_BINS - 1; b++){
+                acc.merge(bins[b]);
+                if(acc.count == 0 || right[b].count == 0) continue;
+                float cost = acc.count * acc.surfaceArea() + right[b].count * right[b].surfaceArea();
+                if(cost < best.cost){
+                    best.cost = cost;
+                    best.axis = axis;
+                    best.bin = b;
+                    best.cmin = cmin[axis];
+                    best.scale = SAH_BINS / extent[axis];
+                    best.left = acc;
+                    best.right = right[b];
+                }
+            }
+        }
+        return best;
+    }
+
+    SharedAABB BVHTree::build_BVH_SAH(vector<SharedAABB>& aabbs, int start, int end, int depth){ //[start, end)
+        if(start == end || start == end - 1){   //leaf node,仅有一个Entity
+            return aabbs[start];
+        }
+        if(depth >= MAX_SPLIT_DEPTH){
+            int axis;
+            int midIndex = medianSplit(aabbs, start, end, axis);
+            return buildChildren(aabbs, start, midIndex, end, depth, axis);
+        }
+        ObjectSplit split = findObjectSplit(aabbs, start, end);
+        int midIndex;
+        if(split.axis == -1){ //所有中心点重合, 按数量对半分
+            midIndex = start + (end - start) / 2;
+        }
+        else{
+            midIndex = partition(aabbs, start, end, [&](const SharedAABB& a){
+                return split.isLeft(*a);
+            });
+        }
+        return buildChildren(aabbs, start, midIndex, end, depth, split.axis == -1 ? 0 : split.axis);
+    }
+
+    //把引用ref裁剪到axis轴上的[lo, hi]之间, 返回裁剪后的包围盒; 三角形按多边形精确裁剪, 其余图元只裁剪包围盒
+    static bool clipReference(const AABB& ref, int axis, float lo, float hi, Vec3& min, Vec3& max){
+        lo = std::max(lo, ref._min[axis]);
+        hi = std::min(hi, ref._max[axis]);
+        if(lo > hi) return false;
+        min = ref._min;
+        max = ref._max;
+        if(ref.type == AABB::Type::TRIANGLE || ref.type == AABB::Type::MESH){
+            Vec3 v[3];
+            if(ref.type == AABB::Type::MESH){
+                v[0] = ref.mt->v0;
+                v[1] = ref.mt->v1;
+                v[2] = ref.mt->v2;
+            }
+            else{
+                v[0] = ref.tr->v1;
+                v[1] = ref.tr->v2;
+                v[2] = ref.tr->v3;
+            }
+            BuildBounds clipped;
+            for(int i = 0; i < 3; i++){
+                const Vec3& p = v[i];
+                const Vec3& q = v[(i + 1) % 3];
+                if(p[axis] >= lo && p[axis] <= hi) clipped.expand(p, p);
+                for(float plane : {lo, hi}){    //边与裁剪平面的交点
+                    if((p[axis] - plane) * (q[axis] - plane) < 0.f){
+                        Vec3 x = p + (q - p) * ((plane - p[axis]) / (q[axis] - p[axis]));
+                        x[axis] = plane;
+                        clipped.expand(x, x);
+                    }
+                }
+            }
+            if(clipped._min.x > clipped._max.x) return false;
+            min = glm::max(min, clipped._min);
+            max = glm::min(max, clipped._max);
+        }
+        min[axis] = std::max(min[axis], lo);
+        max[axis] = std::min(max[axis], hi);
+        return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+    }
+
+    static float overlapArea(const BuildBounds& a, const BuildBounds& b){
+        Vec3 d = glm::min(a._max, b._max) - glm::max(a._min, b._min);
+        if(d.x <= 0.f || d.y <= 0.f || d.z <= 0.f) return 0.f;
+        return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    SharedAABB BVHTree::build_SBVH(vector<SharedAABB>& refs, int depth){
+        int n = int(refs.size());
+        if(n == 1) return refs[0];
+        if(depth >= MAX_SPLIT_DEPTH){   //不再尝试空间划分, 按数量对半分
+            int axis;
+            int midIndex = medianSplit(refs, 0, n, axis);
+            vector<SharedAABB> left(refs.begin(), refs.begin() + midIndex), right(refs.begin() + midIndex, refs.end());
+            refs.clear();
+            refs.shrink_to_fit();
+            return make_shared<AABB>(build_SBVH(left, depth + 1), build_SBVH(right, depth + 1), axis);
+        }
+        ObjectSplit object = findObjectSplit(refs, 0, n);
+
+        //只有物体划分的两侧重叠明显, 且还有复制引用的余量时, 才尝试空间划分
+        vector<SharedAABB> left, right;
+        int axis = object.axis == -1 ? 0 : object.axis;
+        if((object.axis == -1 || overlapArea(object.left, object.right) > SBVH_ALPHA * sbvhRootArea)
+            && sbvhReferences.load() < sbvhBudget){
+            SpatialSplit spatial = findSpatialSplit(refs, reduceBounds(refs, 0, n, false));
+            if(spatial.axis != -1 && spatial.cost < object.cost){
+                int added = splitReferences(refs, spatial, left, right);
+                bool progress = !left.empty() && !right.empty() && int(left.size()) < n && int(right.size()) < n;
+                if(progress && sbvhReferences.fetch_add(added) + added <= sbvhBudget){
+                    axis = spatial.axis;
+                    sbvhSpatialSplits++;
+                }
+                else{
+                    if(progress) sbvhReferences -= added;
+                    left.clear();
+                    right.clear();
+                }
+            }
+        }
+        if(left.empty()){
+            int midIndex;
+            if(object.axis == -1){ //所有中心点重合, 按数量对半分
+                midIndex = n / 2;
+            }
+            else{
+                midIndex = partition(refs, 0, n, [&](const SharedAABB& a){
+                    return object.isLeft(*a);
+                });
+            }
+            left.assign(refs.begin(), refs.begin() + midIndex);
+            right.assign(refs.begin() + midIndex, refs.end());
+        }
+        refs.clear();
+        refs.shrink_to_fit();
+
+        SharedAABB leftNode, rightNode;
+        if(depth < taskDepth && n >= PARALLEL_TASK){
+            auto leftTask = async(launch::async, [&](){ return build_SBVH(left, depth + 1); });
+            rightNode = build_SBVH(right, depth + 1);
+            leftNode = leftTask.get();
+        }
+        else{
+            leftNode = build_SBVH(left, depth + 1);
+            rightNode = build_SBVH(right, depth + 1);
+        }
+        return make_shared<AABB>(leftNode, rightNode, axis);
+    }
+
+    BVHTree::SpatialSplit BVHTree::findSpatialSplit(const vector<SharedAABB>& refs, const BuildBounds& bounds){
+        SpatialSplit best;
+        for(int axis = 0; axis < 3; axis++){
+            float lo = bounds._min[axis];
+            float binSize = (bounds._max[axis] - lo) / SBVH_BINS;
+            if(binSize <= 0.f) continue;
+            //每个引用按bin裁剪后扩展各bin的包围盒, 并记录它进入与离开的bin
+            array<BuildBounds, SBVH_BINS> bins;
+            array<int, SBVH_BINS> enter{}, exit{};
+            for(const auto& ref : refs){
+                int first = std::clamp(int((ref->_min[axis] - lo) / binSize), 0, SBVH_BINS - 1);
+                int last = std::clamp(int((ref->_max[axis] - lo) / binSize), first, SBVH_BINS - 1);
+                for(int b = first; b <= last; b++){
+                    float binLo = b == 0 ? -FLOAT_INF : lo + b * binSize;
+                    float binHi = b == SBVH_BINS - 1 ? FLOAT_INF : lo + (b + 1) * binSize;
+                    Vec3 min, max;
+                    if(clipReference(*ref, axis, binLo, binHi, min, max)) bins[b].expand(min, max);
+                }
+                enter[first]++;
+                exit[last]++;
+            }
+            array<BuildBounds, SBVH_BINS - 1> right;
+            BuildBounds acc;
+            for(int b = SBVH_BINS - 1; b > 0; b--){
+                acc.expand(bins[b]._min, bins[b]._max);
+                acc.count += exit[b];
+                right[b - 1] = acc;
+            }
+            acc = BuildBounds{};
+            for(int b = 0; b < SBVH_BINS - 1; b++){
+                acc.expand(bins[b]._min, bins[b]._max);
+                acc.count += enter[b];
+                if(acc.count == 0 || right[b].count == 0) continue;
+                float cost = acc.count * acc.surfaceArea() + right[b].count * right[b].surfaceArea();
+                if(cost < best.cost){
+                    best.cost = cost;
+                    best.axis = axis;
+                    best.position = lo + (b + 1) * binSize;
+                    best.left = acc;
+                    best.right = right[b];
+                }
+            }
+        }
+        return best;
+    }
+
+    int BVHTree::splitReferences(const vector<SharedAABB>& refs, const SpatialSplit& split, vector<SharedAABB>& left, vector<SharedAABB>& right){
+        int axis = split.axis;
+        float leftArea = split.left.surfaceArea();
+        float rightArea = split.right.surfaceArea();
+        float nl = float(split.left.count), nr = float(split.right.count);
+        int added = 0;
+        for(const auto& ref : refs){
+            if(ref->_max[axis] <= split.position){
+                left.push_back(ref);
+                continue;
+            }
+            if(ref->_min[axis] >= split.position){
+                right.push_back(ref);
+                continue;
+            }
+            //跨越平面的引用: 比较复制与整体放到一侧的开销(reference unsplitting)
+            BuildBounds l = split.left, r = split.right;
+            l.expand(ref->_min, ref->_max);
+            r.expand(ref->_min, ref->_max);
+            float splitCost = leftArea * nl + rightArea * nr;
+            float leftCost = l.surfaceArea() * nl + rightArea * (nr - 1.f);
+            float rightCost = leftArea * (nl - 1.f) + r.surfaceArea() * nr;
+            if(leftCost < splitCost && leftCost <= rightCost){
+                left.push_back(ref);
+                continue;
+            }
+            if(rightCost < splitCost){
+                right.push_back(ref);
+                continue;
+            }
+            Vec3 min, max;
+            bool hasLeft = clipReference(*ref, axis, -FLOAT_INF, split.position, min, max);
+            if(hasLeft){
+                auto clipped = make_shared<AABB>(*ref);
+                clipped->_min = min;
+                clipped->_max = max;
+                clipped->padFlat();
+                left.push_back(clipped);
+            }
+            bool hasRight = clipReference(*ref, axis, split.position, FLOAT_INF, min, max);
+            if(hasRight){
+                auto clipped = make_shared<AABB>(*ref);
+                clipped->_min = min;
+                clipped->_max = max;
+                clipped->padFlat();
+                right.push_back(clipped);
+            }
+            if(!hasLeft && !hasRight) left.push_back(ref);
+            if(hasLeft && hasRight) added++;
+        }
+        return added;
+    }
+
+    //把v的低21位展开, 每两位之间插入两个0
+    static uint64_t expandBits(uint64_t v){
+        v &= 0x1FFFFF;
+        v = (v | v << 32) & 0x1F00000000FFFFull;
+        v = (v | v << 16) & 0x1F0000FF0000FFull;
+        v = (v | v << 8) & 0x100F00F00F00F00Full;
+        v = (v | v << 4) & 0x10C30C30C30C30C3ull;
+        v = (v | v << 2) & 0x1249249249249249ull;
+        return v;
+    }
+
+    void BVHTree::sortMorton(vector<SharedAABB>& aabbs){
+        int n = int(aabbs.size());
+        int bits = n > MORTON_BITS_LARGE ? 21 : 10;    //每个轴的位数
+        BuildBounds centroidBounds = reduceBounds(aabbs, 0, n, true);
+        Vec3 cmin = centroidBounds._min;
+        Vec3 extent = centroidBounds._max - cmin;
+        float cells = float(1 << bits);
+        Vec3 scale = Vec3(extent.x > 0.f ? cells / extent.x : 0.f,
+                          extent.y > 0.f ? cells / extent.y : 0.f,
+                          extent.z > 0.f ? cells / extent.z : 0.f);
+        vector<uint64_t> keys(n);
+        vector<int> values(n);
+        parallelChunks(0, n, [&](int, int chunkStart, int chunkEnd){
+            for(int i = chunkStart; i < chunkEnd; i++){
+                Vec3 q = (aabbs[i]->centroid() - cmin) * scale;
+                uint64_t x = uint64_t(std::clamp(q.x, 0.f, cells - 1.f));
+                uint64_t y = uint64_t(std::clamp(q.y, 0.f, cells - 1.f));
+                uint64_t z = uint64_t(std::clamp(q.z, 0.f, cells - 1.f));
+                keys[i] = expandBits(x) << 2 | expandBits(y) << 1 | expandBits(z);
+                values[i] = i;
+            }
+        });
+
+        //LSD基数排序, 每趟8位: 各块先统计直方图, 再按(桶, 块)的顺序计算写入位置, 最后各块稳定地分散写入
+        constexpr int RADIX = 256;
+        vector<uint64_t> keysTmp(n);
+        vector<int> valuesTmp(n);
+        vector<array<int, RADIX>> histograms(std::max(1, buildThreads));
+        for(int shift = 0; shift < 3 * bits; shift += 8){
+            int chunks = parallelChunks(0, n, [&](int chunk, int chunkStart, int chunkEnd){
+                auto& h = histograms[chunk];
+                h.fill(0);
+                for(int i = chunkStart; i < chunkEnd; i++) h[(keys[i] >> shift) & (RADIX - 1)]++;
+            });
+            int offset = 0;
+            for(int d = 0; d < RADIX; d++){
+                for(int c = 0; c < chunks; c++){
+                    int count = histograms[c][d];
+                    histograms[c][d] = offset;
+                    offset += count;
+                }
+            }
+            parallelChunks(0, n, [&](int chunk, int chunkStart, int chunkEnd){
+                auto& h = histograms[chunk];
+                for(int i = chunkStart; i < chunkEnd; i++){
+                    int dst = h[(keys[i] >> shift) & (RADIX - 1)]++;
+                    keysTmp[dst] = keys[i];
+                    valuesTmp[dst] = values[i];
+                }
+            });
+            keys.swap(keysTmp);
+            values.swap(valuesTmp);
+        }
+
+        vector<SharedAABB> sorted(n);
+        parallelChunks(0, n, [&](int, int chunkStart, int chunkEnd){
+            for(int i = chunkStart; i < chunkEnd; i++) sorted[i] = std::move(aabbs[values[i]]);
+        });
+        aabbs.swap(sorted);
+        mortonCodes.swap(keys);
+    }
+
+    //[start, end)内的Morton码已排序, 在最高的不同位处划分, 使左右子树在空间上分开
+    SharedAABB BVHTree::build_LBVH(vector<SharedAABB>& aabbs, int start, int end, int depth){
+        if(start == end || start == end - 1){
+            return aabbs[start];
+        }
+        uint64_t first = mortonCodes[start];
+        uint64_t last = mortonCodes[end - 1];
+        if(first == last || depth >= MAX_SPLIT_DEPTH){  //Morton码相同或树已过深, 按数量对半分, 保持Morton码有序
+            return buildChildren(aabbs, start, start + (end - start) / 2, end, depth, 0);
+        }
+        int bit = 63 - std::countl_zero(first ^ last);
+        //二分查找第一个该位为1的位置
+        int lo = start + 1, hi = end - 1;
+        while(lo < hi){
+            int mid = (lo + hi) / 2;
+            if((mortonCodes[mid] >> bit) & 1) hi = mid;
+            else lo = mid + 1;
+        }
+        return buildChildren(aabbs, start, lo, end, depth, 2 - bit % 3);   //Morton码中从低到高依次为z, y, x
+    }
+
+    SharedAABB BVHTree::optimizeTreelets(SharedAABB node, int depth, int& count){
+        if(node->type != AABB::Type::NOLEAF){
+            node->sahCost = node->surfaceArea() * SAH_INTERSECT_COST;
+            node->height = 0;
+            count = 1;
+            return node;
+        }
+        int leftCount, rightCount;
+        if(depth < taskDepth){
+            auto leftTask = async(launch::async, [&](){ return optimizeTreelets(node->left, depth + 1, leftCount); });
+            node->right = optimizeTreelets(node->right, depth + 1, rightCount);
+            node->left = leftTask.get();
+        }
+        else{
+            node->left = optimizeTreelets(node->left, depth + 1, leftCount);
+            node->right = optimizeTreelets(node->right, depth + 1, rightCount);
+        }
+        count = leftCount + rightCount;
+        node->sahCost = node->surfaceArea() * SAH_TRAVERSAL_COST + node->left->sahCost + node->right->sahCost;
+        node->height = 1 + std::max(node->left->height, node->right->height);
+        if(count < TREELET_MIN_PRIMITIVES) return node;
+        return restructureTreelet(node, depth);
+    }
+
+    SharedAABB BVHTree::restructureTreelet(const SharedAABB& node, int depth){
+        //从node的两个孩子开始, 每次展开表面积最大的内部节点, 直到有TREELET_LEAVES个叶结点
+        array<SharedAABB, TREELET_LEAVES> leaves;
+        int n = 0;
+        leaves[n++] = node->left;
+        leaves[n++] = node->right;
+        while(n < TREELET_LEAVES){
+            int best = -1;
+            for(int i = 0; i < n; i++){
+                if(leaves[i]->type == AABB::Type::NOLEAF && (best < 0 || leaves[i]->surfaceArea() > leaves[best]->surfaceArea())) best = i;
+            }
+            if(best < 0) break;
+            auto expanded = leaves[best];
+            leaves[best] = expanded->left;
+            leaves[n++] = expanded->right;
+        }
+
+        //对叶结点的每个子集S, 求以S为叶结点的最优子树开销; S的两个划分P与S\P都比S小, 按数值顺序计算即可
+        constexpr int SUBSETS = 1 << TREELET_LEAVES;
+        array<BuildBounds, SUBSETS> bounds;
+        array<float, SUBSETS> cost;
+        array<int, SUBSETS> split;
+        array<int, SUBSETS> height;
+        int full = (1 << n) - 1;
+        for(int S = 1; S <= full; S++){
+            int low = S & -S;
+            int lowIndex = std::countr_zero(unsigned(low));
+            bounds[S] = bounds[S ^ low];
+            bounds[S].expand(leaves[lowIndex]->_min, leaves[lowIndex]->_max);
+            if(S == low){
+                cost[S] = leaves[lowIndex]->sahCost;
+                height[S] = leaves[lowIndex]->height;
+                continue;
+            }
+            float best = FLOAT_INF;
+            split[S] = low;     //开销溢出为无穷大时仍需要一个有效的划分
+            for(int P = (S - 1) & S; P > 0; P = (P - 1) & S){
+                if(!(P & low)) continue;    //P与S\P对称, 只枚举包含最低位的一半
+                float c = cost[P] + cost[S ^ P];
+                if(c < best){
+                    best = c;
+                    split[S] = P;
+                }
+            }
+            cost[S] = bounds[S].surfaceArea() * SAH_TRAVERSAL_COST + best;
+            height[S] = 1 + std::max(height[split[S]], height[S ^ split[S]]);
+        }
+        if(cost[full] >= node->sahCost * 0.999f) return node;  //没有明显改善, 保留原拓扑
+        if(depth + height[full] >= STACK_SIZE) return node;
+
+        function<SharedAABB(int)> rebuild = [&](int S) -> SharedAABB {
+            if((S & (S - 1)) == 0) return leaves[std::countr_zero(unsigned(S))];
+            Vec3 size = bounds[S]._max - bounds[S]._min;
+            int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+            auto result = make_shared<AABB>(rebuild(split[S]), rebuild(S ^ split[S]), axis);
+            result->sahCost = cost[S];
+            result->height = height[S];
+            return result;
+        };
+        return rebuild(full);
+    }
+
+    float BVHTree::computeSAHCost(const SharedAABB& node, array<int, 3>& count){
+        count = {0, 0, 0};
+        if(node->type != AABB::Type::NOLEAF){
+            if(node->type == AABB::Type::TRIANGLE || node->type == AABB::Type::MESH) count[0] = 1;
+            else if(node->type == AABB::Type::SPHERE) count[1] = 1;
+            else count[2] = 1;
+            node->sahCost = node->surfaceArea() * SAH_INTERSECT_COST;
+            return node->sahCost;
+        }
+        array<int, 3> leftCount, rightCount;
+        float cost = node->surfaceArea() * SAH_TRAVERSAL_COST
+            + computeSAHCost(node->left, leftCount) + computeSAHCost(node->right, rightCount);
+        for(int i = 0; i < 3; i++) count[i] = leftCount[i] + rightCount[i];
+        //叶结点中的三角形与球按SoA块求交, 其余图元逐个求交
+        int total = count[0] + count[1] + count[2];
+        float leafCost = node->surfaceArea() * (blockCost(count[0]) + blockCost(count[1]) + count[2] * SAH_INTERSECT_COST);
+        node->leafSize = 0;
+        if(total <= maxLeafSize && leafCost <= cost){
+            node->leafSize = total;
+            cost = leafCost;
+        }
+        node->sahCost = cost;
+        return cost;
+    }
+
+    float BVHTree::blockCost(int n){
+        int rest = n % PRIMITIVE_BLOCK_SIZE;
+        return (n / PRIMITIVE_BLOCK_SIZE) * SAH_BLOCK_COST + (rest == 0 ? 0.f : rest == 1 ? SAH_INTERSECT_COST : SAH_BLOCK_COST);
+    }
+
+    float BVHTree::flatSAHCost() const {
+        auto area = [](const LinearBVHNode& node){
+            Vec3 d = node._max - node._min;
+            return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+        };
+        float cost = 0.f;
+        for(const auto& node : nodes){
+            if(node.nPrimitives == 0){
+                cost += area(node) * SAH_TRAVERSAL_COST;
+                continue;
+            }
+            int triangles = 0, spheres = 0, others = 0;
+            for(int i = node.primitiveOffset; i < node.primitiveOffset + node.nPrimitives; i++){
+                auto type = primitives[i].type;
+                if(type == AABB::Type::TRIANGLE || type == AABB::Type::MESH) triangles++;
+                else if(type == AABB::Type::SPHERE) spheres++;
+                else others++;
+            }
+            cost += area(node) * (blockCost(triangles) + blockCost(spheres) + others * SAH_INTERSECT_COST);
+        }
+        return cost / area(nodes[0]);
+    }
+
+    bool BVHTree::refit(SharedScene spscene, vector<Instance>* instances){
+        auto begin = chrono::steady_clock::now();
+        //结构不匹配时树保持不变, 先把原有的平面记录移出, 失败时再放回, 保证图元中的指针仍然有效
+        vector<PlaneRecord> oldPlaneRecords;
+        oldPlaneRecords.swap(planeRecords);
+        collectLeaves(spscene, instances);
+        bool match = aabbs.size() == size_t(leafIndices.empty() ? 0 : *max_element(leafIndices.begin(), leafIndices.end()) + 1);
+        for(size_t i = 0; match && i < primitives.size(); i++){
+            match = aabbs[leafIndices[i]]->type == primitives[i].type;
+        }
+        if(!match || nodes.empty()){
+            aabbs.clear();
+            buildTriangles.clear();
+            buildTriangles.shrink_to_fit();
+            planeRecords.swap(oldPlaneRecords);
+            return false;
+        }
+        this->spscene = spscene;
+        //图元改为指向新场景中的对象
+        for(size_t i = 0; i < primitives.size(); i++){
+            const auto& leaf = *aabbs[leafIndices[i]];
+            if(leaf.type == AABB::Type::SPHERE) primitives[i].sp = leaf.sp;
+            else if(leaf.type == AABB::Type::PLANE) primitives[i].pl = leaf.pl;
+            else if(leaf.type == AABB::Type::INSTANCE) primitives[i].in = leaf.in;
+            else if(leaf.type == AABB::Type::MESH) primitives[i].mt = leaf.mt;
+            else primitives[i].tr = leaf.tr;
+        }
+        //节点按深度优先顺序存放, 孩子的下标总是大于父节点, 因此倒序遍历即为自底向上
+        for(int i = int(nodes.size()) - 1; i >= 0; i--){
+            auto& node = nodes[i];
+            if(node.nPrimitives > 0){
+                BuildBounds bounds;
+                for(int k = 0; k < node.nPrimitives; k++){
+                    const auto& leaf = *aabbs[leafIndices[node.primitiveOffset + k]];
+                    bounds.expand(leaf._min, leaf._max);
+                }
+                node._min = bounds._min;
+                node._max = bounds._max;
+            }
+            else{
+                node._min = glm::min(nodes[i + 1]._min, nodes[node.secondChildOffset]._min);
+                node._max = glm::max(nodes[i + 1]._max, nodes[node.secondChildOffset]._max);
+            }
+        }
+        aabbs.clear();
+        aabbs.shrink_to_fit();
+        compactTriangles();
+        buildBlocks();
+        sahCost = flatSAHCost();
+        buildTime = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+        return true;
+    }
+
+    int BVHTree::flatten(const SharedAABB& node, int depth){
+        if(depth >= STACK_SIZE){
+            throw runtime_error("BVH is too deep");
+        }
+        int offset = int(nodes.size());
+        nodes.emplace_back();
+        nodes[offset]._min = node->_min;
+        nodes[offset]._max = node->_max;
+        nodes[offset].pad = 0;
+        if(node->type != AABB::Type::NOLEAF || node->leafSize > 0){
+            vector<SharedAABB> leaves;
+            collectSubtree(node, leaves);
+            //三角形排在前面, 其次是球, 便于按连续的同类图元生成SoA块
+            auto group = [](AABB::Type type){
+                if(type == AABB::Type::TRIANGLE || type == AABB::Type::MESH) return 0;
+                return type == AABB::Type::SPHERE ? 1 : 2;
+            };
+            stable_sort(leaves.begin(), leaves.end(), [&](const SharedAABB& a, const SharedAABB& b){
+                return group(a->type) < group(b->type);
+            });
+            nodes[offset].primitiveOffset = int(primitives.size());
+            nodes[offset].nPrimitives = uint16_t(leaves.size());
+            nodes[offset].axis = 0;
+            for(const auto& leaf : leaves){
+                BVHPrimitive primitive;
+                primitive.type = leaf->type;
+                if(leaf->type == AABB::Type::SPHERE) primitive.sp = leaf->sp;
+                else if(leaf->type == AABB::Type::PLANE) primitive.pl = leaf->pl;
+                else if(leaf->type == AABB::Type::TRIANGLE) primitive.tr = leaf->tr;
+                else if(leaf->type == AABB::Type::INSTANCE) primitive.in = leaf->in;
+                else primitive.mt = leaf->mt;
+                leafIndices.push_back(leaf->index);
+                primitives.push_back(primitive);
+            }
+        }
+        else{
+            nodes[offset].nPrimitives = 0;
+            nodes[offset].axis = uint8_t(node->axis);
+            flatten(node->left, depth + 1);
+            int second = flatten(node->right, depth + 1);
+            nodes[offset].secondChildOffset = second;
+        }
+        return offset;
+    }
+
+    void BVHTree::collectSubtree(const SharedAABB& node, vector<SharedAABB>& leaves) const {
+        if(node->type == AABB::Type::NOLEAF){
+            collectSubtree(node->left, leaves);
+            collectSubtree(node->right, leaves);
+            return;
+        }
+        for(const auto& leaf : leaves){
+            if(leaf->index == node->index) return;
+        }
+        leaves.push_back(node);
+    }
+
+    void BVHTree::compactTriangles(){
+        size_t n = 0;
+        for(const auto& primitive : primitives){
+            if(primitive.type == AABB::Type::MESH) n++;
+        }
+        vector<MeshTriangle> compact;
+        compact.reserve(n);
+        for(auto& primitive : primitives){
+            if(primitive.type != AABB::Type::MESH) continue;
+            compact.push_back(*primitive.mt);
+            primitive.mt = &compact.back();
+        }
+        //vector移动后元素的地址不变, 图元中的指针仍然有效
+        meshTriangles = std::move(compact);
+        buildTriangles.clear();
+        buildTriangles.shrink_to_fit();
+    }
+
+    size_t BVHTree::memoryUsage() const {
+        return nodes.size() * sizeof(LinearBVHNode) + primitives.size() * sizeof(BVHPrimitive)
+            + leafIndices.size() * sizeof(int) + meshTriangles.size() * sizeof(MeshTriangle) + planeRecords.size() * sizeof(PlaneRecord)
+            + triangleBlocks.size() * sizeof(TriangleBlock) + sphereBlocks.size() * sizeof(SphereBlock);
+    }
+
+    void BVHTree::buildBlocks(){
+        triangleBlocks.clear();
+        sphereBlocks.clear();
+        for(auto& primitive : primitives) primitive.block = -1;
+        auto isTriangle = [](AABB::Type type){ return type == AABB::Type::TRIANGLE || type == AABB::Type::MESH; };
+        for(const auto& node : nodes){
+            if(node.nPrimitives < 2) continue;
+            int end = node.primitiveOffset + node.nPrimitives;
+            for(int i = node.primitiveOffset; i < end; ){
+                auto type = primitives[i].type;
+                bool triangle = isTriangle(type);
+                int j = i + 1;
+                while(j < end && j - i < PRIMITIVE_BLOCK_SIZE
+                    && (triangle ? isTriangle(primitives[j].type) : primitives[j].type == type)) j++;
+                //只有一个图元时直接单独求交
+                if(j - i < 2 || (!triangle && type != AABB::Type::SPHERE)){
+                    i = j;
+                    continue;
+                }
+                if(triangle){
+                    primitives[i].block = int(triangleBlocks.size());
+                    TriangleBlock& block = triangleBlocks.emplace_back();
+                    block.count = j - i;
+                    for(int k = 0; k < PRIMITIVE_BLOCK_SIZE; k++){
+                        Vec3 v[3] = {Vec3{0.f}, Vec3{0.f}, Vec3{0.f}};
+                        block.primitive[k] = -1;
+                        if(k < block.count && primitives[i + k].type == AABB::Type::MESH){
+                            const MeshTriangle& t = *primitives[i + k].mt;
+                            v[0] = t.v0;
+                            v[1] = t.v1;
+                            v[2] = t.v2;
+                            block.primitive[k] = i + k;
+                        }
+                        else if(k < block.count){
+                            const Triangle& t = *primitives[i + k].tr;
+                            v[0] = t.v1;
+                            v[1] = t.v2;
+                            v[2] = t.v3;
+                            block.primitive[k] = i + k;
+                        }
+                        for(int vertex = 0; vertex < 3; vertex++){
+                            for(int axis = 0; axis < 3; axis++) block.v[vertex][axis][k] = v[vertex][axis];
+                        }
+                    }
+                }
+                else{
+                    primitives[i].block = int(sphereBlocks.size());
+                    SphereBlock& block = sphereBlocks.emplace_back();
+                    block.count = j - i;
+                    for(int k = 0; k < PRIMITIVE_BLOCK_SIZE; k++){
+                        block.cx[k] = block.cy[k] = block.cz[k] = 0.f;
+                        block.r2[k] = -1.f;
+                        block.primitive[k] = -1;
+                        if(k < block.count){
+                            const Sphere& sp = *primitives[i + k].sp;
+                            block.cx[k] = sp.position.x; block.cy[k] = sp.position.y; block.cz[k] = sp.position.z;
+                            block.r2[k] = sp.radius * sp.radius;
+                            block.primitive[k] = i + k;
+                        }
+                    }
+                }
+                i = j;
+            }
+        }
+    }
+
+    void BVHTree::printTree(int index, int depth){
+        if(index >= nodes.size()) return;
+        const auto& node = nodes[index];
+        for(int i = 0; i < depth; i++){
+            cout << "  ";
+        }
+        cout << "min: " << node._min.x << " " << node._min.y << " " << node._min.z << " max: " << node._max.x << " " << node._max.y << " " << node._max.z << endl;
+        if(node.nPrimitives == 0){
+            printTree(index + 1, depth + 1);
+            printTree(node.secondChildOffset, depth + 1);
+        }
+    }
+}
@@ -0,0 +1,204 @@
+#include "accel/BVHDiskCache.hpp"
+#include "server/Server.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Accel
+{
+    namespace
+    {
+        constexpr char CACHE_MAGIC[8] = {'N', 'R', 'B', 'V', 'H', 0, 0, 0};
+        constexpr uint32_t CACHE_VERSION = 1;
+
+        struct CacheHeader
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t nodeSize;          //sizeof(LinearBVHNode), 节点布局变化后旧文件自动失效
+            uint64_t key;
+            uint32_t splitMethod;
+            uint32_t nodeCount;
+            uint32_t primitiveCount;
+            float sahCost;
+        };
+
+        // 只读的内存映射文件
+        class MappedFile
+        {
+        public:
+            MappedFile(const string& path) {
+#ifdef _WIN32
+                file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+                if (file == INVALID_HANDLE_VALUE) return;
+                LARGE_INTEGER fileSize;
+                if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return;
+                mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+                if (mapping == NULL) return;
+                void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                if (view == NULL) return;
+                bytes = static_cast<const char*>(view);
+                length = size_t(fileSize.QuadPart);
+#else
+                fd = open(path.c_str(), O_RDONLY);
+                if (fd < 0) return;
+                struct stat st;
+                if (fstat(fd, &st) != 0 || st.st_size == 0) return;
+                void* view = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (view == MAP_FAILED) return;
+                bytes = static_cast<const char*>(view);
+                length = size_t(st.st_size);
+#endif
+            }
+            MappedFile(const MappedFile&) = delete;
+            ~MappedFile() {
+#ifdef _WIN32
+                if (bytes != nullptr) UnmapViewOfFile(bytes);
+                if (mapping != NULL) CloseHandle(mapping);
+                if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+                if (bytes != nullptr) munmap(const_cast<char*>(bytes), length);
+                if (fd >= 0) close(fd);
+#endif
+            }
+
+            const char* data() const { return bytes; }
+            size_t size() const { return length; }
+
+        private:
+            const char* bytes = nullptr;
+            size_t length = 0;
+#ifdef _WIN32
+            HANDLE file = INVALID_HANDLE_VALUE;
+            HANDLE mapping = NULL;
+#else
+            int fd = -1;
+#endif
+        };
+    }
+
+    BVHDiskCache::BVHDiskCache(const string& directory)
+        : directory     (directory)
+    {}
+
+    string BVHDiskCache::path(uint64_t key) const {
+        stringstream ss;
+        ss << hex << setw(16) << setfill('0') << key << ".bvh";
+        return (filesystem::path(directory) / ss.str()).string();
+    }
+
+    SharedBVHTree BVHDiskCache::load(uint64_t key, const Mesh& mesh, BVHTree::SplitMethod splitMethod) {
+        auto begin = chrono::steady_clock::now();
+        MappedFile file{path(key)};
+        if (file.data() == nullptr || file.size() < sizeof(CacheHeader)) return nullptr;
+        CacheHeader header;
+        memcpy(&header, file.data(), sizeof(header));
+        size_t expected = sizeof(CacheHeader) + size_t(header.nodeCount) * sizeof(LinearBVHNode)
+            + size_t(header.primitiveCount) * sizeof(int32_t);
+        if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION
+            || header.nodeSize != sizeof(LinearBVHNode) || header.key != key
+            || header.splitMethod != uint32_t(splitMethod) || header.nodeCount == 0 || file.size() != expected) {
+            getServer().logger.warning("BVH cache file " + path(key) + " is stale, rebuilding");
+            return nullptr;
+        }
+
+        shared_ptr<BVHTree> bvh{new BVHTree()};
+        bvh->splitMethod = splitMethod;
+        bvh->sahCost = bvh->builtSahCost = header.sahCost;
+        const char* p = file.data() + sizeof(CacheHeader);
+        bvh->nodes.resize(header.nodeCount);
+        memcpy(bvh->nodes.data(), p, size_t(header.nodeCount) * sizeof(LinearBVHNode));
+        p += size_t(header.nodeCount) * sizeof(LinearBVHNode);
+        bvh->leafIndices.resize(header.primitiveCount);
+        memcpy(bvh->leafIndices.data(), p, size_t(header.primitiveCount) * sizeof(int32_t));
+
+        //检查节点中的下标, 损坏的文件不能让遍历越界; 孩子的下标总是大于父节点, 顺序扫描即可求出深度
+        vector<int> depth(header.nodeCount, 0);
+        for (int i = 0; i < int(header.nodeCount); i++) {
+            const auto& node = bvh->nodes[i];
+            bool valid = depth[i] < BVHTree::STACK_SIZE;
+            if (valid && node.nPrimitives > 0) {
+                valid = node.primitiveOffset >= 0 && size_t(node.primitiveOffset) + node.nPrimitives <= bvh->leafIndices.size();
+            }
+            else if (valid) {
+                valid = i + 1 < int(header.nodeCount) && node.secondChildOffset > i + 1 && node.secondChildOffset < int(header.nodeCount);
+                if (valid) depth[i + 1] = depth[node.secondChildOffset] = depth[i] + 1;
+            }
+            if (!valid) {
+                getServer().logger.warning("BVH cache file " + path(key) + " is stale, rebuilding");
+                return nullptr;
+            }
+        }
+
+        //三角形不写入文件, 按序号从mesh中重建
+        int triangleNum = int(mesh.positionIndices.size() / 3);
+        bvh->meshTriangles.resize(header.primitiveCount);
+        bvh->primitives.resize(header.primitiveCount);
+        for (uint32_t i = 0; i < header.primitiveCount; i++) {
+            int index = bvh->leafIndices[i];
+            if (index < 0 || index >= triangleNum) {
+                getServer().logger.warning("BVH cache file " + path(key) + " does not match the mesh, rebuilding");
+                return nullptr;
+            }
+            bvh->meshTriangles[i] = makeMeshTriangle(mesh, index);
+            bvh->primitives[i].type = AABB::Type::MESH;
+            bvh->primitives[i].mt = &bvh->meshTriangles[i];
+        }
+        bvh->buildBlocks();
+        bvh->buildTime = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+        getServer().logger.log("BVH loaded from cache in " + to_string(bvh->buildTime) + " ms: "
+            + to_string(header.primitiveCount) + " primitives");
+        return bvh;
+    }
+
+    void BVHDiskCache::save(uint64_t key, const BVHTree& bvh) {
+        if (bvh.nodes.empty() || bvh.leafIndices.size() != bvh.primitives.size()) return;
+        CacheHeader header;
+        memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.version = CACHE_VERSION;
+        header.nodeSize = sizeof(LinearBVHNode);
+        header.key = key;
+        header.splitMethod = uint32_t(bvh.splitMethod);
+        header.nodeCount = uint32_t(bvh.nodes.size());
+        header.primitiveCount = uint32_t(bvh.primitives.size());
+        header.sahCost = bvh.sahCost;
+
+        //先写入临时文件再改名, 避免其他进程读到写了一半的文件
+        string target = path(key);
+        string temp = target + ".tmp";
+        error_code ec;
+        filesystem::create_directories(directory, ec);
+        {
+            ofstream out(temp, ios::binary | ios::trunc);
+            if (!out) {
+                getServer().logger.warning("Cannot write BVH cache file " + temp);
+                return;
+            }
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(bvh.nodes.data()), bvh.nodes.size() * sizeof(LinearBVHNode));
+            out.write(reinterpret_cast<const char*>(bvh.leafIndices.data()), bvh.leafIndices.size() * sizeof(int32_t));
+            if (!out) {
+                getServer().logger.warning("Cannot write BVH cache file " + temp);
+                out.close();
+                filesystem::remove(temp, ec);
+                return;
+            }
+        }
+        filesystem::rename(temp, target, ec);
+        if (ec) getServer().logger.warning("Cannot write BVH cache file " + target + ": " + ec.message());
+    }
+}
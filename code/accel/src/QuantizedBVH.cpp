@@ -0,0 +1,64 @@
+#include "accel/QuantizedBVH.hpp"
+#include "server/Server.hpp"
+
+#include <chrono>
+#include <cmath>
+
+namespace Accel
+{
+    template<int W>
+    QuantizedBVH<W>::QuantizedBVH(const WideBVH<W>& wide)
+        : binary        (wide.binary)
+    {
+        auto begin = chrono::steady_clock::now();
+        nodes.resize(wide.nodes.size());
+        for (size_t n = 0; n < wide.nodes.size(); n++) {
+            const auto& w = wide.nodes[n];
+            auto& q = nodes[n];
+            const float* wmin[3] = {w.minX, w.minY, w.minZ};
+            const float* wmax[3] = {w.maxX, w.maxY, w.maxZ};
+            uint8_t* qmin[3] = {q.qminX, q.qminY, q.qminZ};
+            uint8_t* qmax[3] = {q.qmaxX, q.qmaxY, q.qmaxZ};
+            q.nChildren = uint8_t(w.nChildren);
+            for (int i = 0; i < W; i++) {
+                q.child[i] = w.child[i];
+                q.count[i] = w.count[i];
+            }
+            for (int axis = 0; axis < 3; axis++) {
+                float lo = FLOAT_INF, hi = -FLOAT_INF;
+                for (int i = 0; i < w.nChildren; i++) {
+                    lo = std::min(lo, wmin[axis][i]);
+                    hi = std::max(hi, wmax[axis][i]);
+                }
+                //取最小的间距2^e, 使254格即可覆盖整个范围, 留一格余量给向外取整
+                int e = -100;
+                if (hi > lo) {
+                    frexp((hi - lo) / 254.f, &e);
+                    e = std::clamp(e, -100, 100);
+                }
+                float scale = ldexp(1.f, e);
+                q.origin[axis] = lo;
+                q.exponent[axis] = int8_t(e);
+                for (int i = 0; i < W; i++) {
+                    if (i >= w.nChildren) {
+                        qmin[axis][i] = 255;
+                        qmax[axis][i] = 0;
+                        continue;
+                    }
+                    //q * scale是精确的, 解码时的一次加法与这里的判断结果一致, 因此解码后的包围盒一定包含原包围盒
+                    int a = std::clamp(int(floor((wmin[axis][i] - lo) / scale)), 0, 255);
+                    while (a > 0 && lo + float(a) * scale > wmin[axis][i]) a--;
+                    int b = std::clamp(int(ceil((wmax[axis][i] - lo) / scale)), 0, 255);
+                    while (b < 255 && lo + float(b) * scale < wmax[axis][i]) b++;
+                    qmin[axis][i] = uint8_t(a);
+                    qmax[axis][i] = uint8_t(b);
+                }
+            }
+        }
+        buildTime = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+        getServer().logger.log("Compressed BVH" + to_string(W) + " built in " + to_string(buildTime) + " ms: "
+            + to_string(wide.memoryUsage() / 1024) + " KB -> " + to_string(memoryUsage() / 1024) + " KB of nodes");
+    }
+
+    template class QuantizedBVH<8>;
+}
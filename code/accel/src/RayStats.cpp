@@ -0,0 +1,94 @@
+#include "accel/RayStats.hpp"
+#include "server/Server.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Accel::Stats
+{
+    using namespace std;
+
+    //正在计数的线程的计数器, 已结束线程释放的计数器, 以及已结束线程累计的计数, 与程序同生命周期
+    struct Registry
+    {
+        mutex lock;
+        vector<unique_ptr<ThreadCounters>> active;
+        vector<unique_ptr<ThreadCounters>> released;
+        int64_t retired[int(Counter::COUNT)] = {};
+    };
+
+    static Registry& registry() {
+        static Registry r;
+        return r;
+    }
+
+    ThreadCounters* registerThread() {
+        auto& r = registry();
+        lock_guard<mutex> guard{r.lock};
+        if (r.released.empty()) {
+            r.active.push_back(make_unique<ThreadCounters>());
+        }
+        else {
+            r.active.push_back(std::move(r.released.back()));
+            r.released.pop_back();
+        }
+        return r.active.back().get();
+    }
+
+    void releaseThread(ThreadCounters* counters) {
+        auto& r = registry();
+        lock_guard<mutex> guard{r.lock};
+        for (int c = 0; c < int(Counter::COUNT); c++) {
+            r.retired[c] += counters->value[c].load(memory_order_relaxed);
+            counters->value[c].store(0, memory_order_relaxed);
+        }
+        auto it = find_if(r.active.begin(), r.active.end(), [&](const unique_ptr<ThreadCounters>& p) { return p.get() == counters; });
+        r.released.push_back(std::move(*it));
+        *it = std::move(r.active.back());
+        r.active.pop_back();
+    }
+
+    int64_t total(Counter c) {
+        auto& r = registry();
+        lock_guard<mutex> guard{r.lock};
+        int64_t sum = r.retired[int(c)];
+        for (auto& counters : r.active) sum += counters->value[int(c)].load(memory_order_relaxed);
+        return sum;
+    }
+
+    void reset() {
+        auto& r = registry();
+        lock_guard<mutex> guard{r.lock};
+        for (auto& v : r.retired) v = 0;
+        for (auto& counters : r.active) {
+            for (auto& v : counters->value) v.store(0, memory_order_relaxed);
+        }
+    }
+
+    void log() {
+#ifdef NR_ACCEL_NO_STATS
+        getServer().logger.log("Ray statistics are compiled out (NR_ACCEL_NO_STATS)");
+#else
+        int64_t rays = total(Counter::RAYS);
+        int64_t shadowRays = total(Counter::SHADOW_RAYS);
+        int64_t paths = total(Counter::PATHS);
+        int64_t queries = rays + shadowRays;
+        getServer().logger.log("Rays: " + to_string(rays) + ", shadow rays: " + to_string(shadowRays));
+        if (queries > 0) {
+            getServer().logger.log("BVH node visits per ray: " + to_string(double(total(Counter::NODES)) / queries)
+                + ", primitive tests per ray: " + to_string(double(total(Counter::PRIMITIVES)) / queries));
+        }
+        if (rays > 0) {
+            getServer().logger.log("Ordered traversal skipped " + to_string(double(total(Counter::CULLED)) / rays)
+                + " subtrees per ray behind the closest hit");
+        }
+        if (paths > 0) {
+            getServer().logger.log("Average path length: " + to_string(double(rays) / paths) + " rays over "
+                + to_string(paths) + " paths");
+        }
+#endif
+    }
+}
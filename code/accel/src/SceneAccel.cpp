@@ -0,0 +1,143 @@
+#include "accel/SceneAccel.hpp"
+#include "accel/intersections.hpp"
+#include "server/Server.hpp"
+
+#include <chrono>
+#include <functional>
+#include <set>
+
+namespace Accel
+{
+    SceneAccel::SceneAccel(SharedScene spScene)
+        : spScene       (spScene)
+        , scene         (*spScene)
+        , bvhLayout     (spScene->renderOption.bvhLayout)
+    {
+        buildInstances();
+        lights.reserve(scene.areaLightBuffer.size());
+        for (auto& a : scene.areaLightBuffer) lights.push_back(makeAreaLightRecord(a));
+        //只修改了变换时重新拟合上一次渲染的顶层BVH
+        bool refitted = false;
+        bvhTree = topLevelBVHCache().get(spScene, instances, scene.renderOption, refitted);
+        const string splitNames[5] = {"Midpoint", "SAH", "LBVH", "LBVH + Treelet", "SBVH"};
+        getServer().logger.log("BVH split: " + splitNames[int(bvhTree->splitMethod)]
+            + ", SAH cost: " + to_string(bvhTree->sahCost));
+        if (bvhLayout == RenderOption::BVHLayout::BVH4) bvh4 = make_shared<WideBVH4>(bvhTree);
+        else if (bvhLayout == RenderOption::BVHLayout::BVH8) bvh8 = make_shared<WideBVH8>(bvhTree);
+        else if (bvhLayout == RenderOption::BVHLayout::BVH8_COMPRESSED) qbvh8 = make_shared<QuantizedBVH8>(WideBVH8{bvhTree});
+    }
+
+    // 为每个Mesh节点创建实例, 底层BVH从内存或磁盘缓存中取得, 只有几何发生变化的Mesh需要重新构建
+    void SceneAccel::buildInstances() {
+        auto& cache = meshBVHCache();
+        int reusedNum = 0;
+        int loadedNum = 0;
+        instances.clear();
+        instances.reserve(scene.nodes.size());
+        for (auto& node : scene.nodes) {
+            if (node.type != Node::Type::MESH) continue;
+            const auto& mesh = scene.meshBuffer[node.entity];
+            if (mesh.positionIndices.size() < 3) continue;
+            MeshBVHCache::Source source;
+            auto blas = cache.get(mesh, scene.renderOption, source);
+            if (source == MeshBVHCache::Source::MEMORY) reusedNum++;
+            else if (source == MeshBVHCache::Source::DISK) loadedNum++;
+            const auto& model = scene.models[node.model];
+            instances.emplace_back(blas, model.translation, model.scale, bvhLayout);
+        }
+        cache.endFrame();
+        getServer().logger.log("Two-level BVH: " + to_string(instances.size()) + " mesh instances, "
+            + to_string(reusedNum) + " reused mesh BVHs, " + to_string(loadedNum) + " loaded from disk");
+    }
+
+    HitRecord SceneAccel::closestHit(const Ray& r, float tMin, float tMax) {
+        Stats::add(Stats::Counter::RAYS);
+        if (bvh4) return Intersection::xBVH(r, *bvh4, tMin, tMax);
+        if (bvh8) return Intersection::xBVH(r, *bvh8, tMin, tMax);
+        if (qbvh8) return Intersection::xBVH(r, *qbvh8, tMin, tMax);
+        return Intersection::xBVH(r, *bvhTree, tMin, tMax);
+    }
+
+    bool SceneAccel::occluded(const Ray& r, float tMin, float tMax) const {
+        Stats::add(Stats::Counter::SHADOW_RAYS);
+        if (bvh4) return Intersection::occluded(r, *bvh4, tMin, tMax);
+        if (bvh8) return Intersection::occluded(r, *bvh8, tMin, tMax);
+        if (qbvh8) return Intersection::occluded(r, *qbvh8, tMin, tMax);
+        return Intersection::occluded(r, *bvhTree, tMin, tMax);
+    }
+
+    void SceneAccel::closestHitPacket(const Ray* rays, int count, float tMin, float tMax, HitRecord* hits) {
+        Stats::add(Stats::Counter::RAYS, count);
+        Intersection::xBVHPacket(rays, count, *bvhTree, tMin, tMax, hits);
+    }
+
+    void SceneAccel::occludedPacket(const Ray* rays, int count, float tMin, const float* tMax, bool* occluded) const {
+        Stats::add(Stats::Counter::SHADOW_RAYS, count);
+        Intersection::occludedPacket(rays, count, *bvhTree, tMin, tMax, occluded);
+    }
+
+    void SceneAccel::logStats() {
+        Stats::log();
+        Stats::reset();
+    }
+
+    void SceneAccel::logLayoutSpeed(const vector<Ray>& rays) {
+        if (bvhLayout == RenderOption::BVHLayout::BINARY) return;
+        //顶层与所有底层BVH的节点内存之和, 几何相同的Mesh共用的底层BVH只计一次
+        set<const MeshBVH*> blases;
+        for (auto& in : instances) blases.insert(in.blas.get());
+        auto nodeMemory = [&](size_t tlasBytes, const function<size_t(const MeshBVH&)>& blasBytes) {
+            size_t bytes = tlasBytes;
+            for (auto blas : blases) bytes += blasBytes(*blas);
+            return bytes;
+        };
+        auto measure = [&](const function<void(const Ray&)>& traverse, const string& name, size_t bytes) {
+            Intersection::resetIntersectionCount();
+            auto begin = chrono::steady_clock::now();
+            for (auto& ray : rays) traverse(ray);
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+            getServer().logger.log(name + ": " + to_string(rays.size() / seconds / 1e6) + " Mrays/s, "
+                + to_string(double(Intersection::getAABBCount()) / rays.size()) + " node visits per ray, "
+                + to_string(bytes / 1024) + " KB of nodes");
+        };
+        //二叉树的测量中实例也遍历二叉的底层BVH
+        for (auto& in : instances) in.layout = RenderOption::BVHLayout::BINARY;
+        measure([&](const Ray& ray){ Intersection::xBVH(ray, *bvhTree, 0.000001, FLOAT_INF); }, "Binary BVH",
+            nodeMemory(bvhTree->nodes.size() * sizeof(LinearBVHNode),
+                [](const MeshBVH& b){ return b.bvh->nodes.size() * sizeof(LinearBVHNode); }));
+        for (auto& in : instances) in.layout = bvhLayout;
+        if (bvh4) measure([&](const Ray& ray){ Intersection::xBVH(ray, *bvh4, 0.000001, FLOAT_INF); }, "BVH4",
+            nodeMemory(bvh4->memoryUsage(), [](const MeshBVH& b){ return b.bvh4->memoryUsage(); }));
+        if (bvh8) measure([&](const Ray& ray){ Intersection::xBVH(ray, *bvh8, 0.000001, FLOAT_INF); }, "BVH8",
+            nodeMemory(bvh8->memoryUsage(), [](const MeshBVH& b){ return b.bvh8->memoryUsage(); }));
+        if (qbvh8) measure([&](const Ray& ray){ Intersection::xBVH(ray, *qbvh8, 0.000001, FLOAT_INF); }, "Compressed BVH8",
+            nodeMemory(qbvh8->memoryUsage(), [](const MeshBVH& b){ return b.qbvh8->memoryUsage(); }));
+        Intersection::resetIntersectionCount();
+    }
+
+    void SceneAccel::logPacketSpeed(const vector<Ray>& rays, int packetSize) {
+        if (packetSize <= 1) return;
+        //与光线包一样, 逐条遍历时实例也走二叉的底层BVH
+        for (auto& in : instances) in.layout = RenderOption::BVHLayout::BINARY;
+        auto measure = [&](const function<void()>& traverse, const string& name) {
+            Intersection::resetIntersectionCount();
+            auto begin = chrono::steady_clock::now();
+            traverse();
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+            getServer().logger.log(name + ": " + to_string(rays.size() / seconds / 1e6) + " Mrays/s, "
+                + to_string(double(Intersection::getAABBCount()) / rays.size()) + " ray-box tests per ray");
+        };
+        measure([&]() {
+            for (auto& ray : rays) Intersection::xBVH(ray, *bvhTree, 0.000001, FLOAT_INF);
+        }, "Single rays");
+        HitRecord hits[Intersection::MAX_PACKET_SIZE];
+        measure([&]() {
+            for (size_t i = 0; i < rays.size(); i += packetSize) {
+                int count = int(min(rays.size() - i, size_t(packetSize)));
+                Intersection::xBVHPacket(rays.data() + i, count, *bvhTree, 0.000001, FLOAT_INF, hits);
+            }
+        }, to_string(packetSize) + "-ray packets");
+        for (auto& in : instances) in.layout = bvhLayout;
+        Intersection::resetIntersectionCount();
+    }
+}
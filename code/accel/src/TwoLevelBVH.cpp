@@ -0,0 +1,107 @@
+#include "accel/TwoLevelBVH.hpp"
+#include "server/Server.hpp"
+
+#include <cstring>
+
+namespace Accel
+{
+    Instance::Instance(SharedMeshBVH blas, const Vec3& translation, const Vec3& scale, RenderOption::BVHLayout layout)
+        : blas          (blas)
+        , translation   (translation)
+        , scale         (scale)
+        , layout        (layout)
+    {
+        //缩放可能为负, 因此两个角点变换后重新取最小/最大值
+        const auto& root = blas->bvh->nodes[0];
+        Vec3 a = root._min * scale + translation;
+        Vec3 b = root._max * scale + translation;
+        _min = glm::min(a, b);
+        _max = glm::max(a, b);
+    }
+
+    static void hashWord(uint64_t& h, uint32_t w) {
+        h ^= w;
+        h *= 0x9E3779B97F4A7C15ull;
+        h ^= h >> 32;
+    }
+
+    uint64_t MeshBVHCache::hashMesh(const Mesh& mesh) {
+        uint64_t h = 0xCBF29CE484222325ull;
+        hashWord(h, uint32_t(mesh.positions.size()));
+        for (const auto& p : mesh.positions) {
+            uint32_t w[3];
+            memcpy(w, &p, sizeof(w));
+            hashWord(h, w[0]);
+            hashWord(h, w[1]);
+            hashWord(h, w[2]);
+        }
+        hashWord(h, uint32_t(mesh.positionIndices.size()));
+        for (auto i : mesh.positionIndices) hashWord(h, i);
+        hashWord(h, uint32_t(mesh.material.getValue()));
+        return h;
+    }
+
+    SharedMeshBVH MeshBVHCache::get(const Mesh& mesh, const RenderOption& option, Source& source) {
+        auto splitMethod = option.bvhSplitMethod;
+        int maxLeafSize = int(option.bvhMaxLeafSize);
+        uint64_t key = hashMesh(mesh) + 0x9E3779B97F4A7C15ull * (uint64_t(splitMethod) + 1)
+            + 0xC2B2AE3D27D4EB4Full * uint64_t(maxLeafSize);
+        lock_guard<mutex> lock{mtx};
+        SharedMeshBVH blas = nullptr;
+        if (auto it = used.find(key); it != used.end()) blas = it->second;
+        else if (auto it = cache.find(key); it != cache.end()) blas = it->second;
+        source = Source::MEMORY;
+        if (blas == nullptr) {
+            blas = make_shared<MeshBVH>();
+            if (option.bvhDiskCache) blas->bvh = diskCache.load(key, mesh, splitMethod);
+            source = Source::DISK;
+            if (blas->bvh == nullptr) {
+                blas->bvh = make_shared<BVHTree>(mesh, splitMethod, maxLeafSize);
+                source = Source::BUILT;
+                if (option.bvhDiskCache) diskCache.save(key, *blas->bvh);
+            }
+        }
+        if (option.bvhLayout == RenderOption::BVHLayout::BVH4 && blas->bvh4 == nullptr) blas->bvh4 = make_shared<WideBVH4>(blas->bvh);
+        if (option.bvhLayout == RenderOption::BVHLayout::BVH8 && blas->bvh8 == nullptr) blas->bvh8 = make_shared<WideBVH8>(blas->bvh);
+        if (option.bvhLayout == RenderOption::BVHLayout::BVH8_COMPRESSED && blas->qbvh8 == nullptr)
+            blas->qbvh8 = make_shared<QuantizedBVH8>(WideBVH8{blas->bvh});
+        used[key] = blas;
+        return blas;
+    }
+
+    void MeshBVHCache::endFrame() {
+        lock_guard<mutex> lock{mtx};
+        cache = std::move(used);
+        used.clear();
+    }
+
+    MeshBVHCache& meshBVHCache() {
+        static MeshBVHCache instance{};
+        return instance;
+    }
+
+    SharedBVHTree TopLevelBVHCache::get(SharedScene spscene, vector<Instance>& instances, const RenderOption& option, bool& refitted) {
+        auto splitMethod = option.bvhSplitMethod;
+        int maxLeafSize = std::clamp(int(option.bvhMaxLeafSize), 1, BVHTree::MAX_LEAF_SIZE);
+        lock_guard<mutex> lock{mtx};
+        refitted = false;
+        if (tlas != nullptr && tlas->splitMethod == splitMethod && tlas->maxLeafSize == maxLeafSize
+            && tlas->refit(spscene, &instances)) {
+            if (tlas->sahCost <= tlas->builtSahCost * BVHTree::REFIT_DEGRADATION) {
+                refitted = true;
+                getServer().logger.log("BVH refitted in " + to_string(tlas->buildTime) + " ms, SAH cost: "
+                    + to_string(tlas->builtSahCost) + " -> " + to_string(tlas->sahCost));
+                return tlas;
+            }
+            getServer().logger.log("BVH quality degraded after refit (SAH cost " + to_string(tlas->builtSahCost)
+                + " -> " + to_string(tlas->sahCost) + "), rebuilding");
+        }
+        tlas = make_shared<BVHTree>(spscene, splitMethod, &instances, maxLeafSize);
+        return tlas;
+    }
+
+    TopLevelBVHCache& topLevelBVHCache() {
+        static TopLevelBVHCache instance{};
+        return instance;
+    }
+}
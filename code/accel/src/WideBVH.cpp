@@ -0,0 +1,88 @@
+#include "accel/WideBVH.hpp"
+#include "server/Server.hpp"
+
+#include <chrono>
+
+namespace Accel
+{
+    static float nodeSurfaceArea(const LinearBVHNode& node) {
+        Vec3 d = node._max - node._min;
+        return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    template<int W>
+    WideBVH<W>::WideBVH(SharedBVHTree binary)
+        : binary        (binary)
+    {
+        auto begin = chrono::steady_clock::now();
+        if (binary->nodes.empty()) return;
+        nodes.reserve(binary->nodes.size() / (W - 1) + 1);
+        collapse(0);
+        buildTime = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+        getServer().logger.log("BVH" + to_string(W) + " collapsed in " + to_string(buildTime) + " ms: "
+            + to_string(binary->nodes.size()) + " binary nodes -> " + to_string(nodes.size()) + " wide nodes");
+    }
+
+    template<int W>
+    int WideBVH<W>::collapse(int index) {
+        const auto& bnodes = binary->nodes;
+        //从二叉节点的两个孩子开始, 每次把表面积最大的内部孩子替换为它的两个孩子, 直到孩子数达到W
+        int children[W];
+        int n = 0;
+        if (bnodes[index].nPrimitives > 0) {
+            children[n++] = index;  //根节点本身是叶结点
+        }
+        else {
+            children[n++] = index + 1;
+            children[n++] = bnodes[index].secondChildOffset;
+        }
+        while (n < W) {
+            int best = -1;
+            float bestArea = -1.f;
+            for (int i = 0; i < n; i++) {
+                const auto& c = bnodes[children[i]];
+                if (c.nPrimitives == 0 && nodeSurfaceArea(c) > bestArea) {
+                    best = i;
+                    bestArea = nodeSurfaceArea(c);
+                }
+            }
+            if (best < 0) break;    //所有孩子都是叶结点
+            int expanded = children[best];
+            children[best] = expanded + 1;
+            children[n++] = bnodes[expanded].secondChildOffset;
+        }
+
+        int wideIndex = int(nodes.size());
+        nodes.emplace_back();
+        {
+            auto& node = nodes[wideIndex];
+            node.nChildren = n;
+            for (int i = 0; i < W; i++) {
+                node.minX[i] = node.minY[i] = node.minZ[i] = FLOAT_INF;
+                node.maxX[i] = node.maxY[i] = node.maxZ[i] = -FLOAT_INF;
+                node.child[i] = -1;
+                node.count[i] = 0;
+            }
+            for (int i = 0; i < n; i++) {
+                const auto& c = bnodes[children[i]];
+                node.minX[i] = c._min.x; node.minY[i] = c._min.y; node.minZ[i] = c._min.z;
+                node.maxX[i] = c._max.x; node.maxY[i] = c._max.y; node.maxZ[i] = c._max.z;
+                if (c.nPrimitives > 0) {
+                    node.child[i] = c.primitiveOffset;
+                    node.count[i] = c.nPrimitives;
+                }
+            }
+        }
+        //递归时nodes可能扩容, 因此每次通过下标重新访问
+        for (int i = 0; i < n; i++) {
+            if (bnodes[children[i]].nPrimitives == 0) {
+                int child = collapse(children[i]);
+                nodes[wideIndex].child[i] = child;
+            }
+        }
+        return wideIndex;
+    }
+
+    template class WideBVH<4>;
+    template class WideBVH<8>;
+}
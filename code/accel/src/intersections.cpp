@@ -0,0 +1,1104 @@
+#include "accel/intersections.hpp"
+#include "server/Server.hpp"
+
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NR_WIDE_BVH_SSE
+#include <immintrin.h>
+#endif
+#if defined(NR_WIDE_BVH_SSE) && defined(__AVX__)
+#define NR_WIDE_BVH_AVX
+#endif
+
+namespace Accel::Intersection
+{
+    // 水密的光线-三角形求交(Woop et al. 2013)中每条光线只需计算一次的数据:
+    // 取方向分量绝对值最大的轴为kz, 坐标轴置换并剪切后光线变为沿z轴的光线, 三角形变换到光线空间后只做二维的边函数测试
+    struct WatertightRay
+    {
+        int kx, ky, kz;
+        float ox, oy, oz;   //置换后的光线原点
+        float Sx, Sy, Sz;
+
+        WatertightRay() = default;
+        WatertightRay(const Ray& ray) {
+            Vec3 absDir = glm::abs(ray.direction);
+            kz = absDir.x > absDir.y ? (absDir.x > absDir.z ? 0 : 2) : (absDir.y > absDir.z ? 1 : 2);
+            kx = (kz + 1) % 3;
+            ky = (kx + 1) % 3;
+            if (ray.direction[kz] < 0) std::swap(kx, ky);   //保持三角形的绕向
+            Sx = ray.direction[kx] / ray.direction[kz];
+            Sy = ray.direction[ky] / ray.direction[kz];
+            Sz = 1.f / ray.direction[kz];
+            ox = ray.origin[kx];
+            oy = ray.origin[ky];
+            oz = ray.origin[kz];
+        }
+    };
+
+    // 平移到光线原点并剪切后的顶点, z未乘Sz
+    struct ShearedVertex
+    {
+        float x, y, z;
+    };
+
+    //按下标直接取分量, 避免glm::vec3::operator[]中的分支
+    inline ShearedVertex shear(const WatertightRay& r, const Vec3& v) {
+        const float* p = &v.x;
+        float z = p[r.kz] - r.oz;
+        return {p[r.kx] - r.ox - r.Sx * z, p[r.ky] - r.oy - r.Sy * z, z};
+    }
+
+    //三角形的三个顶点平移到光线原点并剪切后计算边函数U, V, W, 三者同号时光线穿过三角形
+    //相邻三角形共享的边在两侧算出的边函数互为相反数, 光线不会从共享边上漏过; 恰为0时两侧都算命中, 不影响最近交点
+    //b1, b2为交点处v1, v2的重心坐标
+    inline bool xWatertight(const WatertightRay& r, const Vec3& v0, const Vec3& v1, const Vec3& v2, float tMin, float tMax, float& t, float& b1, float& b2) {
+        ShearedVertex A = shear(r, v0), B = shear(r, v1), C = shear(r, v2);
+        float U = C.x * B.y - C.y * B.x;
+        float V = A.x * C.y - A.y * C.x;
+        if ((U < 0.f || V < 0.f) && (U > 0.f || V > 0.f)) return false;
+        float W = B.x * A.y - B.y * A.x;
+        if ((U < 0.f || V < 0.f || W < 0.f) && (U > 0.f || V > 0.f || W > 0.f)) return false;
+        float det = U + V + W;
+        if (det == 0.f) return false;
+        float T = (U * A.z + V * B.z + W * C.z) * r.Sz;
+        //T与det同时取反后在det缩放的区间上比较, 确认有交点后才做除法
+        if (det < 0.f) { T = -T; det = -det; }
+        if (T < tMin * det || T >= tMax * det) return false;
+        t = T / det;
+        b1 = V / (U + V + W);
+        b2 = W / (U + V + W);
+        return true;
+    }
+
+    // 遍历过程中的候选交点: 只记录距离, 图元与重心坐标, 被更近的交点取代时不浪费任何计算
+    // 交点位置, 法向量与材质由finalizeHit只为最终的最近交点计算一次
+    struct LeanHit
+    {
+        float t = FLOAT_INF;
+        float b1 = 0.f;     //三角形上的重心坐标
+        float b2 = 0.f;
+        const BVHPrimitive* primitive = nullptr;    //为空表示没有交点
+        const Instance* instance = nullptr;     //交点在实例的底层BVH中时所属的实例
+    };
+
+    //实例只有平移与缩放, 物体空间与世界空间中的t相同, 交点直接用世界空间的光线计算
+    HitRecord finalizeHit(const Ray& ray, const LeanHit& hit) {
+        if (!hit.primitive) return getMissRecord();
+        const auto& p = *hit.primitive;
+        Vec3 hitPoint = ray.at(hit.t);
+        if (p.type == AABB::Type::SPHERE) {
+            return getHitRecord(hit.t, hitPoint, (hitPoint - p.sp->position) / p.sp->radius, p.sp->material);
+        }
+        else if (p.type == AABB::Type::PLANE) {
+            return getHitRecord(hit.t, hitPoint, p.pl->normal, p.pl->material);
+        }
+        else if (p.type == AABB::Type::MESH) {
+            Vec3 normal = hit.instance ? hit.instance->normalToWorld(p.mt->normal) : p.mt->normal;
+            return getHitRecord(hit.t, hitPoint, normal, p.mt->getMaterial());
+        }
+        return getHitRecord(hit.t, hitPoint, p.tr->normal, p.tr->material);
+    }
+
+    HitRecord xTriangle(const Ray& ray, const Triangle& t, float tMin, float tMax) {
+        Stats::add(Stats::Counter::PRIMITIVES);
+        float hitT, b1, b2;
+        if (!xWatertight(WatertightRay{ray}, t.v1, t.v2, t.v3, tMin, tMax, hitT, b1, b2)) return getMissRecord();
+        return getHitRecord(hitT, ray.at(hitT), t.normal, t.material);
+    }
+    HitRecord xMeshTriangle(const Ray& ray, const MeshTriangle& t, float tMin, float tMax) {
+        Stats::add(Stats::Counter::PRIMITIVES);
+        float hitT, b1, b2;
+        if (!xWatertight(WatertightRay{ray}, t.v0, t.v1, t.v2, tMin, tMax, hitT, b1, b2)) return getMissRecord();
+        return getHitRecord(hitT, ray.at(hitT), t.normal, t.getMaterial());
+    }
+    //只求交点的距离, 优先取较近的根
+    inline bool xSphere(const Ray& ray, const Sphere& s, float tMin, float tMax, float& t) {
+         Stats::add(Stats::Counter::PRIMITIVES);
+        const auto& position = s.position;
+        const auto& r = s.radius;
+        Vec3 oc = ray.origin - position;
+        float a = glm::dot(ray.direction, ray.direction);
+        float b = glm::dot(oc, ray.direction);
+        float c = glm::dot(oc, oc) - r*r;
+        float discriminant = b*b - a*c;
+        if (discriminant <= 0) return false;
+        float sqrtDiscriminant = sqrt(discriminant);
+        t = (-b - sqrtDiscriminant) / a;
+        if (t < tMax && t >= tMin) return true;
+        t = (-b + sqrtDiscriminant) / a;
+        return t < tMax && t >= tMin;
+    }
+    HitRecord xSphere(const Ray& ray, const Sphere& s, float tMin, float tMax) {
+        float t;
+        if (!xSphere(ray, s, tMin, tMax, t)) return getMissRecord();
+        auto hitPoint = ray.at(t);
+        return getHitRecord(t, hitPoint, (hitPoint - s.position)/s.radius, s.material);
+    }
+    inline bool xPlane(const Ray& ray, const PlaneRecord& p, float tMin, float tMax, float& t) {
+         Stats::add(Stats::Counter::PRIMITIVES);
+        auto Np_dot_d = glm::dot(ray.direction, p.normal);
+        if (Np_dot_d < 0.0000001f && Np_dot_d > -0.00000001f) return false;
+        t = (p.offset - glm::dot(p.normal, ray.origin))/Np_dot_d;
+        if (t >= tMax || t < tMin) return false;
+        // cross test: 用预先计算的逆基求交点的局部坐标
+        Vec3 local = ray.at(t) - p.position;
+        auto u = glm::dot(p.invU, local), v = glm::dot(p.invV, local);
+        return (u<=1 && u>=0) && (v<=1 && v>=0);
+    }
+    HitRecord xPlane(const Ray& ray, const PlaneRecord& p, float tMin, float tMax) {
+        float t;
+        if (!xPlane(ray, p, tMin, tMax, t)) return getMissRecord();
+        return getHitRecord(t, ray.at(t), p.normal, p.material);
+    }
+    HitRecord xAreaLight(const Ray& ray, const AreaLightRecord& a, float tMin, float tMax) {
+        auto Np_dot_d = glm::dot(ray.direction, a.normal);
+        if (Np_dot_d < 0.0000001f && Np_dot_d > -0.00000001f) return getMissRecord(); //ray与光源法向量垂直,无交点
+        float t = (a.offset - glm::dot(a.normal, ray.origin))/Np_dot_d; //计算光线与区域光源的交点在光线上的参数t
+        if (t >= tMax || t < tMin) return getMissRecord(); 
+        // cross test
+        Vec3 hitPoint = ray.at(t); //计算交点位置
+        Vec3 local = hitPoint - a.position;
+        auto u = glm::dot(a.invU, local), v = glm::dot(a.invV, local);  //交点在区域光源局部坐标系中的坐标
+        if ((u<=1 && u>=0) && (v<=1 && v>=0)) { //局部坐标在[0, 1]范围内，说明交点在区域光源的范围内
+            return getHitRecord(t, hitPoint, a.normal, {});
+        }
+        return getMissRecord();
+    }
+
+    //包围盒求交的离开距离乘以1 + 2 * gamma(3), 抵消除法与减法的舍入误差(Ize 2013), 光线经过包围盒的面时不会被误剔除
+    constexpr float ROBUST_EXIT = 1.0000004f;
+
+    static inline bool xAABB(const Ray& ray, const LinearBVHNode& node, float tMin, float tMax, float& tEnter){
+        Stats::add(Stats::Counter::NODES);
+        //对每一对平面 ,进行求交,求出tmin和tmax, 由于每对平面都是axis-aligned
+        Vec3 t_in = (node._min - ray.origin)/ray.direction;
+        Vec3 t_out = (node._max - ray.origin)/ray.direction;
+        for(int i = 0; i < 3; i++){
+            if(ray.direction[i]<0) std::swap(t_in[i], t_out[i]);
+        }
+        tEnter = glm::max(glm::max(glm::max(t_in.x, t_in.y), t_in.z), tMin); //进入时间要取最大值
+        float tExit = glm::min(glm::min(glm::min(t_out.x, t_out.y), t_out.z), tMax) * ROBUST_EXIT; //离开时间要取最小值
+        return tEnter <= tExit; //与[tMin, tMax]范围内的AABB相交
+    }
+
+    // SoA块求交使用的SIMD类型, 宽度与PRIMITIVE_BLOCK_SIZE一致
+#if defined(NR_WIDE_BVH_AVX)
+    struct BlockFloat { __m256 v; };
+    inline BlockFloat bLoad(const float* p) { return {_mm256_loadu_ps(p)}; }
+    inline BlockFloat bSet(float x) { return {_mm256_set1_ps(x)}; }
+    inline BlockFloat operator+(BlockFloat a, BlockFloat b) { return {_mm256_add_ps(a.v, b.v)}; }
+    inline BlockFloat operator-(BlockFloat a, BlockFloat b) { return {_mm256_sub_ps(a.v, b.v)}; }
+    inline BlockFloat operator*(BlockFloat a, BlockFloat b) { return {_mm256_mul_ps(a.v, b.v)}; }
+    inline BlockFloat operator/(BlockFloat a, BlockFloat b) { return {_mm256_div_ps(a.v, b.v)}; }
+    inline BlockFloat bXor(BlockFloat a, BlockFloat b) { return {_mm256_xor_ps(a.v, b.v)}; }
+    inline BlockFloat bAnd(BlockFloat a, BlockFloat b) { return {_mm256_and_ps(a.v, b.v)}; }
+    inline BlockFloat bOr(BlockFloat a, BlockFloat b) { return {_mm256_or_ps(a.v, b.v)}; }
+    inline BlockFloat bMax(BlockFloat a, BlockFloat b) { return {_mm256_max_ps(a.v, b.v)}; }
+    inline BlockFloat bMin(BlockFloat a, BlockFloat b) { return {_mm256_min_ps(a.v, b.v)}; }
+    inline BlockFloat bSqrt(BlockFloat a) { return {_mm256_sqrt_ps(a.v)}; }
+    inline BlockFloat bLess(BlockFloat a, BlockFloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+    inline BlockFloat bLessEqual(BlockFloat a, BlockFloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+    inline BlockFloat bSelect(BlockFloat mask, BlockFloat a, BlockFloat b) { return {_mm256_blendv_ps(b.v, a.v, mask.v)}; }
+    inline int bMask(BlockFloat a) { return _mm256_movemask_ps(a.v); }
+    inline void bStore(float* p, BlockFloat a) { _mm256_storeu_ps(p, a.v); }
+#elif defined(NR_WIDE_BVH_SSE)
+    struct BlockFloat { __m128 v; };
+    inline BlockFloat bLoad(const float* p) { return {_mm_loadu_ps(p)}; }
+    inline BlockFloat bSet(float x) { return {_mm_set1_ps(x)}; }
+    inline BlockFloat operator+(BlockFloat a, BlockFloat b) { return {_mm_add_ps(a.v, b.v)}; }
+    inline BlockFloat operator-(BlockFloat a, BlockFloat b) { return {_mm_sub_ps(a.v, b.v)}; }
+    inline BlockFloat operator*(BlockFloat a, BlockFloat b) { return {_mm_mul_ps(a.v, b.v)}; }
+    inline BlockFloat operator/(BlockFloat a, BlockFloat b) { return {_mm_div_ps(a.v, b.v)}; }
+    inline BlockFloat bXor(BlockFloat a, BlockFloat b) { return {_mm_xor_ps(a.v, b.v)}; }
+    inline BlockFloat bAnd(BlockFloat a, BlockFloat b) { return {_mm_and_ps(a.v, b.v)}; }
+    inline BlockFloat bOr(BlockFloat a, BlockFloat b) { return {_mm_or_ps(a.v, b.v)}; }
+    inline BlockFloat bMax(BlockFloat a, BlockFloat b) { return {_mm_max_ps(a.v, b.v)}; }
+    inline BlockFloat bMin(BlockFloat a, BlockFloat b) { return {_mm_min_ps(a.v, b.v)}; }
+    inline BlockFloat bSqrt(BlockFloat a) { return {_mm_sqrt_ps(a.v)}; }
+    inline BlockFloat bLess(BlockFloat a, BlockFloat b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+    inline BlockFloat bLessEqual(BlockFloat a, BlockFloat b) { return {_mm_cmple_ps(a.v, b.v)}; }
+    inline BlockFloat bSelect(BlockFloat mask, BlockFloat a, BlockFloat b) { return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))}; }
+    inline int bMask(BlockFloat a) { return _mm_movemask_ps(a.v); }
+    inline void bStore(float* p, BlockFloat a) { _mm_storeu_ps(p, a.v); }
+#endif
+
+    //取tHit中有效且最近的一项, 返回它在块中的位置, 没有有效项时返回-1
+    inline int nearestLane(int mask, const float* tHit, float& t) {
+        int lane = -1;
+        for (int k = 0; k < PRIMITIVE_BLOCK_SIZE; k++) {
+            if ((mask & (1 << k)) && (lane < 0 || tHit[k] < t)) {
+                lane = k;
+                t = tHit[k];
+            }
+        }
+        return lane;
+    }
+
+    inline Vec3 blockVertex(const TriangleBlock& b, int vertex, int k) {
+        return {b.v[vertex][0][k], b.v[vertex][1][k], b.v[vertex][2][k]};
+    }
+
+    //与xWatertight相同的水密求交, 块中所有三角形同时计算; 返回最近交点所在的位置, 没有交点时返回-1
+    //重心坐标只为最近的交点计算
+    inline int xTriangleBlock(const WatertightRay& wr, const TriangleBlock& b, float tMin, float tMax, float& t, float& b1, float& b2) {
+        Stats::add(Stats::Counter::PRIMITIVES, b.count);
+        float tHit[PRIMITIVE_BLOCK_SIZE];
+#if defined(NR_WIDE_BVH_SSE)
+        int lanes = (1 << b.count) - 1;
+        //坐标轴置换只是按kx, ky, kz选取块中的行
+        BlockFloat ox = bSet(wr.ox), oy = bSet(wr.oy), oz = bSet(wr.oz);
+        BlockFloat Sx = bSet(wr.Sx), Sy = bSet(wr.Sy);
+        BlockFloat x[3], y[3], z[3];
+        for (int i = 0; i < 3; i++) {
+            z[i] = bLoad(b.v[i][wr.kz]) - oz;
+            x[i] = bLoad(b.v[i][wr.kx]) - ox - Sx * z[i];
+            y[i] = bLoad(b.v[i][wr.ky]) - oy - Sy * z[i];
+        }
+        BlockFloat U = x[2] * y[1] - y[2] * x[1];
+        BlockFloat V = x[0] * y[2] - y[0] * x[2];
+        BlockFloat W = x[1] * y[0] - y[1] * x[0];
+        BlockFloat zero = bSet(0.f);
+        //边函数中既有负值又有正值时光线从三角形外经过
+        BlockFloat negative = bLess(bMin(U, bMin(V, W)), zero);
+        BlockFloat positive = bLess(zero, bMax(U, bMax(V, W)));
+        BlockFloat det = U + V + W;
+        BlockFloat T = (U * z[0] + V * z[1] + W * z[2]) * bSet(wr.Sz);
+        BlockFloat sign = bAnd(det, bSet(-0.f));
+        det = bXor(det, sign);
+        T = bXor(T, sign);
+        BlockFloat valid = bAnd(bLess(zero, det), bAnd(bLessEqual(bSet(tMin) * det, T), bLess(T, bSet(tMax) * det)));
+        int mask = bMask(valid) & ~bMask(bAnd(negative, positive)) & lanes;
+        //大多数块没有交点, 此时省掉除法
+        if (mask == 0) return -1;
+        bStore(tHit, T / det);
+        int lane = nearestLane(mask, tHit, t);
+        float vHit[PRIMITIVE_BLOCK_SIZE], wHit[PRIMITIVE_BLOCK_SIZE], detHit[PRIMITIVE_BLOCK_SIZE];
+        bStore(vHit, bXor(V, sign));
+        bStore(wHit, bXor(W, sign));
+        bStore(detHit, det);
+        b1 = vHit[lane] / detHit[lane];
+        b2 = wHit[lane] / detHit[lane];
+        return lane;
+#else
+        int mask = 0;
+        float b1Hit[PRIMITIVE_BLOCK_SIZE], b2Hit[PRIMITIVE_BLOCK_SIZE];
+        for (int k = 0; k < b.count; k++) {
+            if (xWatertight(wr, blockVertex(b, 0, k), blockVertex(b, 1, k), blockVertex(b, 2, k), tMin, tMax, tHit[k], b1Hit[k], b2Hit[k])) mask |= 1 << k;
+        }
+        int lane = nearestLane(mask, tHit, t);
+        if (lane >= 0) {
+            b1 = b1Hit[lane];
+            b2 = b2Hit[lane];
+        }
+        return lane;
+#endif
+    }
+
+    //与xSphere相同, 优先取较近的根; 返回最近交点所在的位置, 没有交点时返回-1
+    inline int xSphereBlock(const Ray& ray, const SphereBlock& b, float tMin, float tMax, float& t) {
+        Stats::add(Stats::Counter::PRIMITIVES, b.count);
+        float tHit[PRIMITIVE_BLOCK_SIZE];
+        float a = glm::dot(ray.direction, ray.direction);
+#if defined(NR_WIDE_BVH_SSE)
+        BlockFloat ocx = bSet(ray.origin.x) - bLoad(b.cx);
+        BlockFloat ocy = bSet(ray.origin.y) - bLoad(b.cy);
+        BlockFloat ocz = bSet(ray.origin.z) - bLoad(b.cz);
+        BlockFloat bb = ocx * bSet(ray.direction.x) + ocy * bSet(ray.direction.y) + ocz * bSet(ray.direction.z);
+        BlockFloat c = ocx * ocx + ocy * ocy + ocz * ocz - bLoad(b.r2);
+        BlockFloat disc = bb * bb - bSet(a) * c;
+        BlockFloat sq = bSqrt(bMax(disc, bSet(0.f)));
+        BlockFloat t0 = (bSet(0.f) - bb - sq) / bSet(a);
+        BlockFloat t1 = (sq - bb) / bSet(a);
+        BlockFloat lo = bSet(tMin), hi = bSet(tMax);
+        BlockFloat near = bAnd(bLessEqual(lo, t0), bLess(t0, hi));
+        BlockFloat far = bAnd(bLessEqual(lo, t1), bLess(t1, hi));
+        BlockFloat valid = bAnd(bLess(bSet(0.f), disc), bOr(near, far));
+        bStore(tHit, bSelect(near, t0, t1));
+        int mask = bMask(valid);
+#else
+        int mask = 0;
+        for (int k = 0; k < b.count; k++) {
+            Vec3 oc = ray.origin - Vec3{b.cx[k], b.cy[k], b.cz[k]};
+            float bb = glm::dot(oc, ray.direction);
+            float disc = bb * bb - a * (glm::dot(oc, oc) - b.r2[k]);
+            if (disc <= 0) continue;
+            float sq = sqrt(disc);
+            tHit[k] = (-bb - sq) / a;
+            if (tHit[k] >= tMin && tHit[k] < tMax) { mask |= 1 << k; continue; }
+            tHit[k] = (-bb + sq) / a;
+            if (tHit[k] >= tMin && tHit[k] < tMax) mask |= 1 << k;
+        }
+#endif
+        return nearestLane(mask, tHit, t);
+    }
+
+    LeanHit xBVHLean(const Ray& ray, const BVHTree& bvh, float tMin, float tMax);
+    template<class Tree>
+    LeanHit xWideBVH(const Ray& ray, const Tree& bvh, float tMin, float tMax);
+
+    //在物体空间中遍历底层BVH, 交点记录所属的实例, 法向量在finalizeHit中才变换回世界空间
+    inline bool xInstance(const Ray& ray, const Instance& in, float tMin, float tMax, LeanHit& hit) {
+        Ray local = in.toObject(ray);
+        LeanHit localHit;
+        if (in.layout == RenderOption::BVHLayout::BVH4) localHit = xWideBVH(local, *in.blas->bvh4, tMin, tMax);
+        else if (in.layout == RenderOption::BVHLayout::BVH8) localHit = xWideBVH(local, *in.blas->bvh8, tMin, tMax);
+        else if (in.layout == RenderOption::BVHLayout::BVH8_COMPRESSED) localHit = xWideBVH(local, *in.blas->qbvh8, tMin, tMax);
+        else localHit = xBVHLean(local, *in.blas->bvh, tMin, tMax);
+        if (!localHit.primitive) return false;
+        hit = localHit;
+        hit.instance = &in;
+        return true;
+    }
+
+    HitRecord xInstance(const Ray& ray, const Instance& in, float tMin, float tMax) {
+        LeanHit hit;
+        if (!xInstance(ray, in, tMin, tMax, hit)) return getMissRecord();
+        return finalizeHit(ray, hit);
+    }
+
+    //遍历BVH时使用, 三角形的剪切变换由调用者对每条光线只计算一次; (tMin, tMax)内有交点时写入hit
+    inline bool xPrimitive(const Ray& ray, const WatertightRay& wr, const BVHPrimitive& p, float tMin, float tMax, LeanHit& hit) {
+        float t, b1 = 0.f, b2 = 0.f;
+        bool found;
+        if(p.type == AABB::Type::SPHERE) {
+            found = xSphere(ray, *p.sp, tMin, tMax, t);
+        }
+        else if(p.type == AABB::Type::PLANE) {
+            found = xPlane(ray, *p.pl, tMin, tMax, t);
+        }
+        else if(p.type == AABB::Type::INSTANCE) {
+            return xInstance(ray, *p.in, tMin, tMax, hit);
+        }
+        else if(p.type == AABB::Type::MESH) {
+            Stats::add(Stats::Counter::PRIMITIVES);
+            found = xWatertight(wr, p.mt->v0, p.mt->v1, p.mt->v2, tMin, tMax, t, b1, b2);
+        }
+        else {
+            Stats::add(Stats::Counter::PRIMITIVES);
+            found = xWatertight(wr, p.tr->v1, p.tr->v2, p.tr->v3, tMin, tMax, t, b1, b2);
+        }
+        if (found) hit = {t, b1, b2, &p, nullptr};
+        return found;
+    }
+
+    HitRecord xPrimitive(const Ray& ray, const BVHPrimitive& p, float tMin, float tMax) {
+        LeanHit hit;
+        if (!xPrimitive(ray, WatertightRay{ray}, p, tMin, tMax, hit)) return getMissRecord();
+        return finalizeHit(ray, hit);
+    }
+
+    bool occPrimitive(const Ray& ray, const WatertightRay& wr, const BVHPrimitive& p, float tMin, float tMax);
+
+    //与叶结点中[first, first + count)的图元求交, 带有SoA块的连续三角形与球整块测试; 找到更近的交点时缩小tMax
+    inline void xLeaf(const Ray& ray, const WatertightRay& wr, const BVHTree& bvh, int first, int count, float tMin, float& tMax, LeanHit& closest) {
+        const auto& primitives = bvh.primitives;
+        for (int i = first; i < first + count; ) {
+            const auto& p = primitives[i];
+            if (p.block < 0) {
+                if (xPrimitive(ray, wr, p, tMin, tMax, closest)) tMax = closest.t;
+                i++;
+                continue;
+            }
+            float t;
+            if (p.type == AABB::Type::SPHERE) {
+                const auto& block = bvh.sphereBlocks[p.block];
+                int lane = xSphereBlock(ray, block, tMin, tMax, t);
+                if (lane >= 0) {
+                    closest = {t, 0.f, 0.f, &primitives[block.primitive[lane]], nullptr};
+                    tMax = t;
+                }
+                i += block.count;
+            }
+            else {
+                const auto& block = bvh.triangleBlocks[p.block];
+                float b1, b2;
+                int lane = xTriangleBlock(wr, block, tMin, tMax, t, b1, b2);
+                if (lane >= 0) {
+                    closest = {t, b1, b2, &primitives[block.primitive[lane]], nullptr};
+                    tMax = t;
+                }
+                i += block.count;
+            }
+        }
+    }
+
+    inline bool occLeaf(const Ray& ray, const WatertightRay& wr, const BVHTree& bvh, int first, int count, float tMin, float tMax) {
+        const auto& primitives = bvh.primitives;
+        for (int i = first; i < first + count; ) {
+            const auto& p = primitives[i];
+            float t, b1, b2;
+            if (p.block < 0) {
+                if (occPrimitive(ray, wr, p, tMin, tMax)) return true;
+                i++;
+            }
+            else if (p.type == AABB::Type::SPHERE) {
+                if (xSphereBlock(ray, bvh.sphereBlocks[p.block], tMin, tMax, t) >= 0) return true;
+                i += bvh.sphereBlocks[p.block].count;
+            }
+            else {
+                if (xTriangleBlock(wr, bvh.triangleBlocks[p.block], tMin, tMax, t, b1, b2) >= 0) return true;
+                i += bvh.triangleBlocks[p.block].count;
+            }
+        }
+        return false;
+    }
+
+    //使用显式栈遍历展开后的BVH, 避免递归与指针跳转
+    //在父节点处测试两个孩子的包围盒, 先访问入口距离更近的孩子, 更远的孩子连同入口距离一起入栈;
+    //每找到一个交点就把tMax缩小到该交点, 出栈时入口距离已超过tMax的子树整棵跳过
+    LeanHit xBVHLean(const Ray& ray, const BVHTree& bvh, float tMin, float tMax) {
+        LeanHit closest;
+        if (bvh.nodes.empty()) return closest;
+        WatertightRay watertightRay{ray};
+        int stack[BVHTree::STACK_SIZE];
+        float stackEnter[BVHTree::STACK_SIZE];
+        int stackSize = 0;
+        float tEnter;
+        if (!xAABB(ray, bvh.nodes[0], tMin, tMax, tEnter)) return closest;
+        stack[stackSize] = 0;
+        stackEnter[stackSize++] = tEnter;
+        while (stackSize > 0) {
+            --stackSize;
+            if (stackEnter[stackSize] > tMax) { //入口已经在最近交点之后
+                Stats::add(Stats::Counter::CULLED);
+                continue;
+            }
+            const auto& node = bvh.nodes[stack[stackSize]];
+            if (node.nPrimitives > 0) {
+                xLeaf(ray, watertightRay, bvh, node.primitiveOffset, node.nPrimitives, tMin, tMax, closest);
+                continue;
+            }
+            int near = stack[stackSize] + 1;
+            int far = node.secondChildOffset;
+            float tNear, tFar;
+            bool hitNear = xAABB(ray, bvh.nodes[near], tMin, tMax, tNear);
+            bool hitFar = xAABB(ray, bvh.nodes[far], tMin, tMax, tFar);
+            if (hitNear && hitFar && tFar < tNear) {
+                std::swap(near, far);
+                std::swap(tNear, tFar);
+            }
+            //后进先出, 先压入较远的孩子
+            if (hitFar) {
+                stack[stackSize] = far;
+                stackEnter[stackSize++] = tFar;
+            }
+            if (hitNear) {
+                stack[stackSize] = near;
+                stackEnter[stackSize++] = tNear;
+            }
+        }
+        return closest;
+    }
+
+    HitRecord xBVH(const Ray& ray, const BVHTree& bvh, float tMin, float tMax) {
+        return finalizeHit(ray, xBVHLean(ray, bvh, tMin, tMax));
+    }
+
+    inline bool occTriangle(const WatertightRay& wr, const Triangle& t, float tMin, float tMax) {
+        Stats::add(Stats::Counter::PRIMITIVES);
+        float hitT, b1, b2;
+        return xWatertight(wr, t.v1, t.v2, t.v3, tMin, tMax, hitT, b1, b2);
+    }
+    bool occTriangle(const Ray& ray, const Triangle& t, float tMin, float tMax) {
+        return occTriangle(WatertightRay{ray}, t, tMin, tMax);
+    }
+
+    inline bool occMeshTriangle(const WatertightRay& wr, const MeshTriangle& t, float tMin, float tMax) {
+        Stats::add(Stats::Counter::PRIMITIVES);
+        float hitT, b1, b2;
+        return xWatertight(wr, t.v0, t.v1, t.v2, tMin, tMax, hitT, b1, b2);
+    }
+    bool occMeshTriangle(const Ray& ray, const MeshTriangle& t, float tMin, float tMax) {
+        return occMeshTriangle(WatertightRay{ray}, t, tMin, tMax);
+    }
+
+    bool occSphere(const Ray& ray, const Sphere& s, float tMin, float tMax) {
+        Stats::add(Stats::Counter::PRIMITIVES);
+        Vec3 oc = ray.origin - s.position;
+        float a = glm::dot(ray.direction, ray.direction);
+        float b = glm::dot(oc, ray.direction);
+        float c = glm::dot(oc, oc) - s.radius*s.radius;
+        float discriminant = b*b - a*c;
+        if (discriminant <= 0) return false;
+        float sqrtDiscriminant = sqrt(discriminant);
+        float temp = (-b - sqrtDiscriminant) / a;
+        if (temp < tMax && temp >= tMin) return true;
+        temp = (-b + sqrtDiscriminant) / a;
+        return temp < tMax && temp >= tMin;
+    }
+
+    bool occPlane(const Ray& ray, const PlaneRecord& p, float tMin, float tMax) {
+        Stats::add(Stats::Counter::PRIMITIVES);
+        auto Np_dot_d = glm::dot(ray.direction, p.normal);
+        if (Np_dot_d < 0.0000001f && Np_dot_d > -0.00000001f) return false;
+        float t = (p.offset - glm::dot(p.normal, ray.origin))/Np_dot_d;
+        if (t >= tMax || t < tMin) return false;
+        Vec3 local = ray.at(t) - p.position;
+        float u = glm::dot(p.invU, local), v = glm::dot(p.invV, local);
+        return (u<=1 && u>=0) && (v<=1 && v>=0);
+    }
+
+    bool occInstance(const Ray& ray, const Instance& in, float tMin, float tMax) {
+        Ray local = in.toObject(ray);
+        if (in.layout == RenderOption::BVHLayout::BVH4) return occluded(local, *in.blas->bvh4, tMin, tMax);
+        if (in.layout == RenderOption::BVHLayout::BVH8) return occluded(local, *in.blas->bvh8, tMin, tMax);
+        if (in.layout == RenderOption::BVHLayout::BVH8_COMPRESSED) return occluded(local, *in.blas->qbvh8, tMin, tMax);
+        return occluded(local, *in.blas->bvh, tMin, tMax);
+    }
+
+    bool occPrimitive(const Ray& ray, const WatertightRay& wr, const BVHPrimitive& p, float tMin, float tMax) {
+        if(p.type == AABB::Type::SPHERE) {
+            return occSphere(ray, *p.sp, tMin, tMax);
+        }
+        else if(p.type == AABB::Type::PLANE) {
+            return occPlane(ray, *p.pl, tMin, tMax);
+        }
+        else if(p.type == AABB::Type::INSTANCE) {
+            return occInstance(ray, *p.in, tMin, tMax);
+        }
+        else if(p.type == AABB::Type::MESH) {
+            return occMeshTriangle(wr, *p.mt, tMin, tMax);
+        }
+        return occTriangle(wr, *p.tr, tMin, tMax);
+    }
+
+    bool occPrimitive(const Ray& ray, const BVHPrimitive& p, float tMin, float tMax) {
+        return occPrimitive(ray, WatertightRay{ray}, p, tMin, tMax);
+    }
+
+    //任意命中即可返回, 因此不需要对孩子排序
+    bool occluded(const Ray& ray, const BVHTree& bvh, float tMin, float tMax) {
+        if (bvh.nodes.empty()) return false;
+        WatertightRay watertightRay{ray};
+        int stack[BVHTree::STACK_SIZE];
+        int stackSize = 0;
+        int current = 0;
+        float tEnter;
+        while (true) {
+            const auto& node = bvh.nodes[current];
+            //叶结点也先测试自身的包围盒, 未命中时跳过其中的图元
+            if (xAABB(ray, node, tMin, tMax, tEnter)) {
+                if (node.nPrimitives > 0) {
+                    if (occLeaf(ray, watertightRay, bvh, node.primitiveOffset, node.nPrimitives, tMin, tMax)) return true;
+                }
+                else {
+                    stack[stackSize++] = node.secondChildOffset;
+                    current = current + 1;
+                    continue;
+                }
+            }
+            if (stackSize == 0) break;
+            current = stack[--stackSize];
+        }
+        return false;
+    }
+
+    // 多叉BVH遍历时每条光线只需计算一次的数据
+    struct WideRay
+    {
+        Vec3 origin;
+        Vec3 invDir;
+        bool dirNeg[3];     //方向分量为负时, 近平面是max, 远平面是min
+
+        WideRay(const Ray& ray)
+            : origin        (ray.origin)
+            , invDir        (1.f / ray.direction)
+        {
+            for (int i = 0; i < 3; i++) dirNeg[i] = ray.direction[i] < 0;
+        }
+    };
+
+    // 多叉节点中孩子包围盒的近/远平面, 已按光线方向符号选好
+    // 方向分量为负时近平面是max, 因此空盒(min = INF, max = -INF)必然不相交
+    struct WidePlanes
+    {
+        const float* nearX; const float* nearY; const float* nearZ;
+        const float* farX; const float* farY; const float* farZ;
+
+        WidePlanes(const WideRay& ray, const float* minX, const float* minY, const float* minZ,
+            const float* maxX, const float* maxY, const float* maxZ)
+            : nearX         (ray.dirNeg[0] ? maxX : minX)
+            , nearY         (ray.dirNeg[1] ? maxY : minY)
+            , nearZ         (ray.dirNeg[2] ? maxZ : minZ)
+            , farX          (ray.dirNeg[0] ? minX : maxX)
+            , farY          (ray.dirNeg[1] ? minY : maxY)
+            , farZ          (ray.dirNeg[2] ? minZ : maxZ)
+        {}
+    };
+
+    //与从first开始的4个孩子的包围盒求交, 返回相交孩子的位掩码, 入口距离写入tEnter
+    inline int xAABB4(const WideRay& ray, const WidePlanes& planes, int first, float tMin, float tMax, float* tEnter) {
+        const float* nearX = planes.nearX + first;
+        const float* nearY = planes.nearY + first;
+        const float* nearZ = planes.nearZ + first;
+        const float* farX = planes.farX + first;
+        const float* farY = planes.farY + first;
+        const float* farZ = planes.farZ + first;
+#ifdef NR_WIDE_BVH_SSE
+        __m128 ox = _mm_set1_ps(ray.origin.x), oy = _mm_set1_ps(ray.origin.y), oz = _mm_set1_ps(ray.origin.z);
+        __m128 ix = _mm_set1_ps(ray.invDir.x), iy = _mm_set1_ps(ray.invDir.y), iz = _mm_set1_ps(ray.invDir.z);
+        __m128 t0 = _mm_max_ps(
+            _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nearX), ox), ix), _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nearY), oy), iy)),
+            _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nearZ), oz), iz), _mm_set1_ps(tMin)));
+        __m128 t1 = _mm_min_ps(
+            _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(farX), ox), ix), _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(farY), oy), iy)),
+            _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(farZ), oz), iz), _mm_set1_ps(tMax)));
+        t1 = _mm_mul_ps(t1, _mm_set1_ps(ROBUST_EXIT));
+        _mm_storeu_ps(tEnter, t0);
+        return _mm_movemask_ps(_mm_cmple_ps(t0, t1));
+#else
+        int mask = 0;
+        for (int i = 0; i < 4; i++) {
+            float t0 = glm::max(glm::max((nearX[i] - ray.origin.x) * ray.invDir.x, (nearY[i] - ray.origin.y) * ray.invDir.y),
+                glm::max((nearZ[i] - ray.origin.z) * ray.invDir.z, tMin));
+            float t1 = glm::min(glm::min((farX[i] - ray.origin.x) * ray.invDir.x, (farY[i] - ray.origin.y) * ray.invDir.y),
+                glm::min((farZ[i] - ray.origin.z) * ray.invDir.z, tMax)) * ROBUST_EXIT;
+            tEnter[i] = t0;
+            if (t0 <= t1) mask |= 1 << i;
+        }
+        return mask;
+#endif
+    }
+
+    //与8个孩子的包围盒求交
+    inline int xAABB8(const WideRay& ray, const WidePlanes& planes, float tMin, float tMax, float* tEnter) {
+#ifdef NR_WIDE_BVH_AVX
+        __m256 ox = _mm256_set1_ps(ray.origin.x), oy = _mm256_set1_ps(ray.origin.y), oz = _mm256_set1_ps(ray.origin.z);
+        __m256 ix = _mm256_set1_ps(ray.invDir.x), iy = _mm256_set1_ps(ray.invDir.y), iz = _mm256_set1_ps(ray.invDir.z);
+        __m256 t0 = _mm256_max_ps(
+            _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(planes.nearX), ox), ix), _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(planes.nearY), oy), iy)),
+            _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(planes.nearZ), oz), iz), _mm256_set1_ps(tMin)));
+        __m256 t1 = _mm256_min_ps(
+            _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(planes.farX), ox), ix), _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(planes.farY), oy), iy)),
+            _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(planes.farZ), oz), iz), _mm256_set1_ps(tMax)));
+        t1 = _mm256_mul_ps(t1, _mm256_set1_ps(ROBUST_EXIT));
+        _mm256_storeu_ps(tEnter, t0);
+        return _mm256_movemask_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ));
+#else
+        //没有AVX时拆成两次4路测试
+        return xAABB4(ray, planes, 0, tMin, tMax, tEnter) | (xAABB4(ray, planes, 4, tMin, tMax, tEnter + 4) << 4);
+#endif
+    }
+
+    inline int xWideAABB(const WideRay& ray, const WideBVHNode<4>& node, float tMin, float tMax, float* tEnter) {
+        Stats::add(Stats::Counter::NODES);
+        WidePlanes planes{ray, node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ};
+        return xAABB4(ray, planes, 0, tMin, tMax, tEnter);
+    }
+
+    inline int xWideAABB(const WideRay& ray, const WideBVHNode<8>& node, float tMin, float tMax, float* tEnter) {
+        Stats::add(Stats::Counter::NODES);
+        WidePlanes planes{ray, node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ};
+        return xAABB8(ray, planes, tMin, tMax, tEnter);
+    }
+
+    //把8个量化坐标解码为浮点: origin + q * scale, scale为2的整数次幂, 乘法是精确的
+    inline void dequantize8(const uint8_t* q, float origin, float scale, float* out) {
+#ifdef NR_WIDE_BVH_SSE
+        __m128i zero = _mm_setzero_si128();
+        __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(q));
+        __m128i words = _mm_unpacklo_epi8(bytes, zero);
+        __m128 o = _mm_set1_ps(origin), s = _mm_set1_ps(scale);
+        _mm_store_ps(out, _mm_add_ps(o, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)), s)));
+        _mm_store_ps(out + 4, _mm_add_ps(o, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero)), s)));
+#else
+        for (int i = 0; i < 8; i++) out[i] = origin + float(q[i]) * scale;
+#endif
+    }
+
+    //压缩节点先解码出孩子的包围盒, 再与未压缩的节点走同样的测试; 解码后的包围盒总是包含原包围盒, 不会漏掉交点
+    inline int xWideAABB(const WideRay& ray, const QuantizedBVHNode<8>& node, float tMin, float tMax, float* tEnter) {
+        Stats::add(Stats::Counter::NODES);
+        alignas(32) float bounds[6][8];
+        const uint8_t* q[6] = {node.qminX, node.qminY, node.qminZ, node.qmaxX, node.qmaxY, node.qmaxZ};
+        float scale[3];
+        for (int axis = 0; axis < 3; axis++) {
+            //直接拼出2^e的位模式, 避免调用ldexp
+            uint32_t bits = uint32_t(node.exponent[axis] + 127) << 23;
+            memcpy(&scale[axis], &bits, sizeof(float));
+        }
+        for (int i = 0; i < 6; i++) dequantize8(q[i], node.origin[i % 3], scale[i % 3], bounds[i]);
+        WidePlanes planes{ray, bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5]};
+        return xAABB8(ray, planes, tMin, tMax, tEnter);
+    }
+
+    // 多叉BVH遍历栈中的一项, count > 0 时为叶孩子
+    struct WideStackEntry
+    {
+        int child;
+        int count;
+        float tEnter;
+    };
+
+    //与二叉树的有序遍历相同: 命中的孩子按入口距离从远到近入栈, 先访问近的孩子, 找到交点后缩小tMax
+    template<class Tree>
+    LeanHit xWideBVH(const Ray& ray, const Tree& bvh, float tMin, float tMax) {
+        constexpr int W = Tree::WIDTH;
+        LeanHit closest;
+        if (bvh.nodes.empty()) return closest;
+        WideRay wideRay{ray};
+        WatertightRay watertightRay{ray};
+        WideStackEntry stack[Tree::STACK_SIZE + 1];
+        int stackSize = 0;
+        stack[stackSize++] = {0, 0, tMin};
+        while (stackSize > 0) {
+            auto entry = stack[--stackSize];
+            if (entry.tEnter > tMax) { //入口已经在最近交点之后
+                Stats::add(Stats::Counter::CULLED);
+                continue;
+            }
+            if (entry.count > 0) {
+                xLeaf(ray, watertightRay, *bvh.binary, entry.child, entry.count, tMin, tMax, closest);
+                continue;
+            }
+            const auto& node = bvh.nodes[entry.child];
+            float tEnter[W];
+            int mask = xWideAABB(wideRay, node, tMin, tMax, tEnter);
+            //按入口距离从大到小插入排序
+            int order[W];
+            int nHit = 0;
+            for (int i = 0; i < node.nChildren; i++) {
+                if (!(mask & (1 << i))) continue;
+                int j = nHit++;
+                while (j > 0 && tEnter[order[j - 1]] < tEnter[i]) {
+                    order[j] = order[j - 1];
+                    j--;
+                }
+                order[j] = i;
+            }
+            for (int k = 0; k < nHit; k++) {
+                int i = order[k];
+                stack[stackSize++] = {node.child[i], node.count[i], tEnter[i]};
+            }
+        }
+        return closest;
+    }
+
+    //任意命中即可返回: 命中的叶孩子立即求交, 内部孩子直接入栈
+    template<class Tree>
+    bool occludedWide(const Ray& ray, const Tree& bvh, float tMin, float tMax) {
+        constexpr int W = Tree::WIDTH;
+        if (bvh.nodes.empty()) return false;
+        WideRay wideRay{ray};
+        WatertightRay watertightRay{ray};
+        int stack[Tree::STACK_SIZE + 1];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0) {
+            const auto& node = bvh.nodes[stack[--stackSize]];
+            float tEnter[W];
+            int mask = xWideAABB(wideRay, node, tMin, tMax, tEnter);
+            for (int i = 0; i < node.nChildren; i++) {
+                if (!(mask & (1 << i))) continue;
+                if (node.count[i] == 0) {
+                    stack[stackSize++] = node.child[i];
+                    continue;
+                }
+                if (occLeaf(ray, watertightRay, *bvh.binary, node.child[i], node.count[i], tMin, tMax)) return true;
+            }
+        }
+        return false;
+    }
+
+    HitRecord xBVH(const Ray& ray, const WideBVH4& bvh, float tMin, float tMax) {
+        return finalizeHit(ray, xWideBVH(ray, bvh, tMin, tMax));
+    }
+
+    HitRecord xBVH(const Ray& ray, const WideBVH8& bvh, float tMin, float tMax) {
+        return finalizeHit(ray, xWideBVH(ray, bvh, tMin, tMax));
+    }
+
+    bool occluded(const Ray& ray, const WideBVH4& bvh, float tMin, float tMax) {
+        return occludedWide(ray, bvh, tMin, tMax);
+    }
+
+    bool occluded(const Ray& ray, const WideBVH8& bvh, float tMin, float tMax) {
+        return occludedWide(ray, bvh, tMin, tMax);
+    }
+
+    HitRecord xBVH(const Ray& ray, const QuantizedBVH8& bvh, float tMin, float tMax) {
+        return finalizeHit(ray, xWideBVH(ray, bvh, tMin, tMax));
+    }
+
+    bool occluded(const Ray& ray, const QuantizedBVH8& bvh, float tMin, float tMax) {
+        return occludedWide(ray, bvh, tMin, tMax);
+    }
+
+    // 光线包遍历的数据: 原点与方向倒数按分量存放, 每次用SIMD测试4条光线
+    struct RayPacket
+    {
+        const Ray* rays;
+        WatertightRay watertight[MAX_PACKET_SIZE];
+        alignas(16) float ox[MAX_PACKET_SIZE];
+        alignas(16) float oy[MAX_PACKET_SIZE];
+        alignas(16) float oz[MAX_PACKET_SIZE];
+        alignas(16) float ix[MAX_PACKET_SIZE];
+        alignas(16) float iy[MAX_PACKET_SIZE];
+        alignas(16) float iz[MAX_PACKET_SIZE];
+        alignas(16) float tMax[MAX_PACKET_SIZE];   //每条光线当前的最近交点, 不在包中的槽位为-INF
+        uint32_t active;        //还需要继续遍历的光线
+        //活动光线的方向在每个轴上都同号时, 用原点与方向倒数的范围做区间算术, 可以整包剔除节点
+        bool coherent;
+        Vec3 originLo, originHi;
+        Vec3 invDirLo, invDirHi;
+    };
+
+    //依次取出mask中每一位对应的光线
+    template<typename F>
+    inline void forEachLane(uint32_t mask, F&& f) {
+        for (; mask != 0; mask &= mask - 1) f(std::countr_zero(mask));
+    }
+
+    inline void initPacket(RayPacket& p, const Ray* rays, uint32_t mask, const float* tMax) {
+        p.rays = rays;
+        p.active = mask;
+        for (int k = 0; k < MAX_PACKET_SIZE; k++) {
+            //不在包中的槽位离开距离为-INF, 包围盒测试必然不相交
+            p.ox[k] = p.oy[k] = p.oz[k] = 0.f;
+            p.ix[k] = p.iy[k] = p.iz[k] = 0.f;
+            p.tMax[k] = -FLOAT_INF;
+        }
+        bool first = true;
+        forEachLane(mask, [&](int k) {
+            const Ray& r = rays[k];
+            Vec3 invDir = 1.f / r.direction;
+            p.watertight[k] = WatertightRay{r};
+            p.ox[k] = r.origin.x; p.oy[k] = r.origin.y; p.oz[k] = r.origin.z;
+            p.ix[k] = invDir.x; p.iy[k] = invDir.y; p.iz[k] = invDir.z;
+            p.tMax[k] = tMax[k];
+            if (first) {
+                p.originLo = p.originHi = r.origin;
+                p.invDirLo = p.invDirHi = invDir;
+                first = false;
+            }
+            else {
+                p.originLo = glm::min(p.originLo, r.origin);
+                p.originHi = glm::max(p.originHi, r.origin);
+                p.invDirLo = glm::min(p.invDirLo, invDir);
+                p.invDirHi = glm::max(p.invDirHi, invDir);
+            }
+        });
+        p.coherent = !first;
+        for (int i = 0; i < 3; i++) {
+            bool sameSign = p.invDirLo[i] > 0.f || p.invDirHi[i] < 0.f;
+            if (!sameSign || !std::isfinite(p.invDirLo[i]) || !std::isfinite(p.invDirHi[i])) p.coherent = false;
+        }
+    }
+
+    //区间[aLo, aHi]与同号区间[bLo, bHi]的乘积
+    inline void intervalMul(float aLo, float aHi, float bLo, float bHi, float& lo, float& hi) {
+        float p0 = aLo * bLo, p1 = aLo * bHi, p2 = aHi * bLo, p3 = aHi * bHi;
+        lo = glm::min(glm::min(p0, p1), glm::min(p2, p3));
+        hi = glm::max(glm::max(p0, p1), glm::max(p2, p3));
+    }
+
+    //区间算术的视锥剔除: 包内任一光线的入口距离不小于enterLo, 离开距离不大于exitHi, enterLo > exitHi时整包都错过节点
+    //舍入是单调的, 因此结果与逐条光线的测试保持一致, 不会剔除逐条测试会命中的节点
+    inline bool packetMissesNode(const RayPacket& p, const LinearBVHNode& node, float tMin, float tMax) {
+        float enterLo = tMin, exitHi = tMax;
+        for (int i = 0; i < 3; i++) {
+            float minLo, minHi, maxLo, maxHi;
+            intervalMul(node._min[i] - p.originHi[i], node._min[i] - p.originLo[i], p.invDirLo[i], p.invDirHi[i], minLo, minHi);
+            intervalMul(node._max[i] - p.originHi[i], node._max[i] - p.originLo[i], p.invDirLo[i], p.invDirHi[i], maxLo, maxHi);
+            if (p.invDirLo[i] > 0.f) {
+                enterLo = glm::max(enterLo, minLo);
+                exitHi = glm::min(exitHi, maxHi);
+            }
+            else {
+                enterLo = glm::max(enterLo, maxLo);
+                exitHi = glm::min(exitHi, minHi);
+            }
+        }
+        return enterLo > exitHi * ROBUST_EXIT;
+    }
+
+    //包中从first开始的4条光线与节点包围盒求交, 返回相交光线的位掩码
+    inline uint32_t xAABBPacket4(const RayPacket& p, int first, const LinearBVHNode& node, float tMin) {
+#ifdef NR_WIDE_BVH_SSE
+        __m128 ox = _mm_load_ps(p.ox + first), oy = _mm_load_ps(p.oy + first), oz = _mm_load_ps(p.oz + first);
+        __m128 ix = _mm_load_ps(p.ix + first), iy = _mm_load_ps(p.iy + first), iz = _mm_load_ps(p.iz + first);
+        __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node._min.x), ox), ix);
+        __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node._max.x), ox), ix);
+        __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node._min.y), oy), iy);
+        __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node._max.y), oy), iy);
+        __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node._min.z), oz), iz);
+        __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node._max.z), oz), iz);
+        __m128 t0 = _mm_max_ps(
+            _mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+            _mm_max_ps(_mm_min_ps(z0, z1), _mm_set1_ps(tMin)));
+        __m128 t1 = _mm_min_ps(
+            _mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)),
+            _mm_min_ps(_mm_max_ps(z0, z1), _mm_load_ps(p.tMax + first)));
+        t1 = _mm_mul_ps(t1, _mm_set1_ps(ROBUST_EXIT));
+        return uint32_t(_mm_movemask_ps(_mm_cmple_ps(t0, t1))) << first;
+#else
+        uint32_t mask = 0;
+        for (int k = first; k < first + 4; k++) {
+            float x0 = (node._min.x - p.ox[k]) * p.ix[k], x1 = (node._max.x - p.ox[k]) * p.ix[k];
+            float y0 = (node._min.y - p.oy[k]) * p.iy[k], y1 = (node._max.y - p.oy[k]) * p.iy[k];
+            float z0 = (node._min.z - p.oz[k]) * p.iz[k], z1 = (node._max.z - p.oz[k]) * p.iz[k];
+            float t0 = glm::max(glm::max(glm::min(x0, x1), glm::min(y0, y1)), glm::max(glm::min(z0, z1), tMin));
+            float t1 = glm::min(glm::min(glm::max(x0, x1), glm::max(y0, y1)), glm::min(glm::max(z0, z1), p.tMax[k])) * ROBUST_EXIT;
+            if (t0 <= t1) mask |= 1u << k;
+        }
+        return mask;
+#endif
+    }
+
+    //mask中的光线与节点包围盒求交, 只测试含有活动光线的4条一组
+    inline uint32_t xAABBPacket(const RayPacket& p, const LinearBVHNode& node, float tMin, uint32_t mask) {
+        Stats::add(Stats::Counter::NODES, std::popcount(mask));
+        uint32_t hit = 0;
+        for (int first = 0; first < MAX_PACKET_SIZE; first += 4) {
+            if ((mask >> first) & 0xF) hit |= xAABBPacket4(p, first, node, tMin);
+        }
+        return hit & mask;
+    }
+
+    //按深度优先遍历二叉BVH, 栈中记录每个节点仍与之相交的光线; leaf(first, count, mask)处理叶结点中的图元
+    //孩子的先后由第一条相交光线在划分轴上的方向决定
+    template<typename Leaf>
+    inline void traversePacket(RayPacket& p, const BVHTree& bvh, float tMin, Leaf&& leaf) {
+        if (bvh.nodes.empty()) return;
+        struct Entry
+        {
+            int node;
+            uint32_t mask;
+        };
+        Entry stack[BVHTree::STACK_SIZE];
+        int stackSize = 0;
+        stack[stackSize++] = {0, p.active};
+        while (stackSize > 0) {
+            auto [index, mask] = stack[--stackSize];
+            mask &= p.active;
+            if (mask == 0) continue;
+            const auto& node = bvh.nodes[index];
+            if (p.coherent) {
+                float tMax = -FLOAT_INF;
+                forEachLane(mask, [&](int k) { tMax = glm::max(tMax, p.tMax[k]); });
+                if (packetMissesNode(p, node, tMin, tMax)) continue;
+            }
+            mask = xAABBPacket(p, node, tMin, mask);
+            if (mask == 0) continue;
+            if (node.nPrimitives > 0) {
+                leaf(node.primitiveOffset, node.nPrimitives, mask);
+                continue;
+            }
+            int near = index + 1;
+            int far = node.secondChildOffset;
+            if (p.rays[std::countr_zero(mask)].direction[node.axis] < 0) std::swap(near, far);
+            stack[stackSize++] = {far, mask};
+            stack[stackSize++] = {near, mask};
+        }
+    }
+
+    //从primitives[i]开始的一个图元或一整个SoA块包含的图元数
+    inline int primitiveRun(const BVHTree& bvh, const BVHPrimitive& p) {
+        if (p.block < 0) return 1;
+        if (p.type == AABB::Type::SPHERE) return bvh.sphereBlocks[p.block].count;
+        return bvh.triangleBlocks[p.block].count;
+    }
+
+    void xPacket(RayPacket& p, const BVHTree& bvh, float tMin, LeanHit* hits);
+
+    //mask中的光线变换到物体空间后成包遍历实例的底层BVH, 变换只有平移与缩放, t不变
+    inline void xInstancePacket(RayPacket& p, uint32_t mask, const Instance& in, float tMin, LeanHit* hits) {
+        Ray local[MAX_PACKET_SIZE];
+        LeanHit localHits[MAX_PACKET_SIZE];
+        forEachLane(mask, [&](int k) { local[k] = in.toObject(p.rays[k]); });
+        RayPacket localPacket;
+        initPacket(localPacket, local, mask, p.tMax);
+        xPacket(localPacket, *in.blas->bvh, tMin, localHits);
+        forEachLane(mask, [&](int k) {
+            if (!localHits[k].primitive) return;
+            hits[k] = localHits[k];
+            hits[k].instance = &in;
+            p.tMax[k] = hits[k].t;
+        });
+    }
+
+    void xPacket(RayPacket& p, const BVHTree& bvh, float tMin, LeanHit* hits) {
+        traversePacket(p, bvh, tMin, [&](int first, int count, uint32_t mask) {
+            for (int i = first; i < first + count; ) {
+                const auto& prim = bvh.primitives[i];
+                if (prim.type == AABB::Type::INSTANCE) {
+                    xInstancePacket(p, mask, *prim.in, tMin, hits);
+                    i++;
+                    continue;
+                }
+                int n = primitiveRun(bvh, prim);
+                forEachLane(mask, [&](int k) {
+                    xLeaf(p.rays[k], p.watertight[k], bvh, i, n, tMin, p.tMax[k], hits[k]);
+                });
+                i += n;
+            }
+        });
+    }
+
+    void xBVHPacket(const Ray* rays, int count, const BVHTree& bvh, float tMin, float tMax, HitRecord* hits) {
+        float tMaxs[MAX_PACKET_SIZE];
+        LeanHit lean[MAX_PACKET_SIZE];
+        for (int k = 0; k < count; k++) tMaxs[k] = tMax;
+        RayPacket p;
+        initPacket(p, rays, (1u << count) - 1, tMaxs);
+        xPacket(p, bvh, tMin, lean);
+        for (int k = 0; k < count; k++) hits[k] = finalizeHit(rays[k], lean[k]);
+    }
+
+    void occPacket(RayPacket& p, const BVHTree& bvh, float tMin, bool* occluded);
+
+    inline void occInstancePacket(RayPacket& p, uint32_t mask, const Instance& in, float tMin, bool* occluded) {
+        Ray local[MAX_PACKET_SIZE];
+        forEachLane(mask, [&](int k) { local[k] = in.toObject(p.rays[k]); });
+        RayPacket localPacket;
+        initPacket(localPacket, local, mask, p.tMax);
+        occPacket(localPacket, *in.blas->bvh, tMin, occluded);
+        //被遮挡的光线不再继续遍历
+        p.active &= localPacket.active | ~mask;
+    }
+
+    //被遮挡的光线从p.active中移除, 所有光线都被遮挡时遍历提前结束
+    void occPacket(RayPacket& p, const BVHTree& bvh, float tMin, bool* occluded) {
+        traversePacket(p, bvh, tMin, [&](int first, int count, uint32_t mask) {
+            for (int i = first; i < first + count && (mask &= p.active) != 0; ) {
+                const auto& prim = bvh.primitives[i];
+                if (prim.type == AABB::Type::INSTANCE) {
+                    occInstancePacket(p, mask, *prim.in, tMin, occluded);
+                    i++;
+                    continue;
+                }
+                int n = primitiveRun(bvh, prim);
+                forEachLane(mask, [&](int k) {
+                    if (occLeaf(p.rays[k], p.watertight[k], bvh, i, n, tMin, p.tMax[k])) {
+                        occluded[k] = true;
+                        p.active &= ~(1u << k);
+                    }
+                });
+                i += n;
+            }
+        });
+    }
+
+    void occludedPacket(const Ray* rays, int count, const BVHTree& bvh, float tMin, const float* tMax, bool* occluded) {
+        for (int k = 0; k < count; k++) occluded[k] = false;
+        RayPacket p;
+        initPacket(p, rays, (1u << count) - 1, tMax);
+        occPacket(p, bvh, tMin, occluded);
+    }
+
+    int64_t getIntersectionCount() {
+        return Stats::total(Stats::Counter::PRIMITIVES);
+    }
+
+    int64_t getAABBCount() {
+        return Stats::total(Stats::Counter::NODES);
+    }
+
+    void resetIntersectionCount() {
+        Stats::reset();
+    }
+}
\ No newline at end of file
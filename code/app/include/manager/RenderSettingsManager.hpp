@@ -3,6 +3,7 @@
 #define __NR_RENDER_SETTINGS_MANAGER_HPP__
 
 #include "scene/Camera.hpp"
+#include "scene/Scene.hpp"
 
 namespace NRenderer
 {
@@ -14,6 +15,16 @@ namespace NRenderer
         unsigned int samplesPerPixel;
         unsigned int photonNum;
         unsigned int samplePhotonNum;
+        RenderOption::BVHSplitMethod bvhSplitMethod;
+        RenderOption::BVHLayout bvhLayout;
+        bool bvhDiskCache;
+        unsigned int bvhMaxLeafSize;
+        unsigned int rayPacketSize;
+        bool bvhBenchmark;
+        unsigned int randomSeed;
+        RenderOption::SampleMethod sampleMethod;
+        bool adaptiveSampling;
+        float adaptiveThreshold;
 
         RenderSettings()
             : width             (500)
@@ -22,6 +33,16 @@ namespace NRenderer
             , samplesPerPixel   (16)
             , photonNum         (100000)
             , samplePhotonNum   (10)
+            , bvhSplitMethod    (RenderOption::BVHSplitMethod::SAH)
+            , bvhLayout         (RenderOption::BVHLayout::BINARY)
+            , bvhDiskCache      (true)
+            , bvhMaxLeafSize    (4)
+            , rayPacketSize     (1)
+            , bvhBenchmark      (false)
+            , randomSeed        (0)
+            , sampleMethod      (RenderOption::SampleMethod::RANDOM)
+            , adaptiveSampling  (false)
+            , adaptiveThreshold (0.05f)
         {}
     };
     struct AmbientSettings
@@ -10,6 +10,16 @@ namespace NRenderer
         ro.height = renderSettings.height;
         ro.photonNum = renderSettings.photonNum;
         ro.samplePhotonNum = renderSettings.samplePhotonNum;
+        ro.bvhSplitMethod = renderSettings.bvhSplitMethod;
+        ro.bvhLayout = renderSettings.bvhLayout;
+        ro.bvhDiskCache = renderSettings.bvhDiskCache;
+        ro.bvhMaxLeafSize = renderSettings.bvhMaxLeafSize;
+        ro.rayPacketSize = renderSettings.rayPacketSize;
+        ro.bvhBenchmark = renderSettings.bvhBenchmark;
+        ro.randomSeed = renderSettings.randomSeed;
+        ro.sampleMethod = renderSettings.sampleMethod;
+        ro.adaptiveSampling = renderSettings.adaptiveSampling;
+        ro.adaptiveThreshold = renderSettings.adaptiveThreshold;
         this->scene->renderOption = ro;
     }
 
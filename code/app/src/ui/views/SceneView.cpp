@@ -43,6 +43,62 @@ namespace NRenderer
         ImGui::InputScalar("Sample Nums", ImGuiDataType_U32, &rs.samplesPerPixel, &intStep, NULL, "%u");
         ImGui::InputScalar("photon Num", ImGuiDataType_U32, &rs.photonNum, &intStep, NULL, "%u");
         ImGui::InputScalar("Sample Photon Num", ImGuiDataType_U32, &rs.samplePhotonNum, &intStep, NULL, "%u");
+        const string splitStr[5] = {"Midpoint", "SAH", "LBVH", "LBVH + Treelet", "SBVH"};
+        int currSplit = int(rs.bvhSplitMethod);
+        if (ImGui::BeginCombo("BVH Split##RenderSettings", splitStr[currSplit].c_str())) {
+            for (int i=0; i<5; i++) {
+                bool selected = currSplit == i;
+                if (ImGui::Selectable((splitStr[i]+"##BVHSplitItem").c_str(), &selected)) {
+                    rs.bvhSplitMethod = RenderOption::BVHSplitMethod(i);
+                    currSplit = i;
+                }
+            }
+            ImGui::EndCombo();
+        }
+        const string layoutStr[4] = {"Binary", "BVH4", "BVH8", "Compressed BVH8"};
+        int currLayout = int(rs.bvhLayout);
+        if (ImGui::BeginCombo("BVH Layout##RenderSettings", layoutStr[currLayout].c_str())) {
+            for (int i=0; i<4; i++) {
+                bool selected = currLayout == i;
+                if (ImGui::Selectable((layoutStr[i]+"##BVHLayoutItem").c_str(), &selected)) {
+                    rs.bvhLayout = RenderOption::BVHLayout(i);
+                    currLayout = i;
+                }
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::Checkbox("BVH Disk Cache##RenderSettings", &rs.bvhDiskCache);
+        ImGui::InputScalar("BVH Max Leaf Size", ImGuiDataType_U32, &rs.bvhMaxLeafSize, &intStep, NULL, "%u");
+        const string packetStr[4] = {"Off", "4 Rays", "8 Rays", "16 Rays"};
+        const unsigned int packetSizes[4] = {1, 4, 8, 16};
+        int currPacket = 0;
+        for (int i=0; i<4; i++) if (rs.rayPacketSize == packetSizes[i]) currPacket = i;
+        if (ImGui::BeginCombo("Ray Packet##RenderSettings", packetStr[currPacket].c_str())) {
+            for (int i=0; i<4; i++) {
+                bool selected = currPacket == i;
+                if (ImGui::Selectable((packetStr[i]+"##RayPacketItem").c_str(), &selected)) {
+                    rs.rayPacketSize = packetSizes[i];
+                    currPacket = i;
+                }
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::Checkbox("BVH Benchmark##RenderSettings", &rs.bvhBenchmark);
+        ImGui::InputScalar("Random Seed", ImGuiDataType_U32, &rs.randomSeed, &intStep, NULL, "%u");
+        const string samplerStr[4] = {"Random", "Sobol", "Halton", "Blue Noise"};
+        int currSampler = int(rs.sampleMethod);
+        if (ImGui::BeginCombo("Sampler##RenderSettings", samplerStr[currSampler].c_str())) {
+            for (int i=0; i<4; i++) {
+                bool selected = currSampler == i;
+                if (ImGui::Selectable((samplerStr[i]+"##SamplerItem").c_str(), &selected)) {
+                    rs.sampleMethod = RenderOption::SampleMethod(i);
+                    currSampler = i;
+                }
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::Checkbox("Adaptive Sampling##RenderSettings", &rs.adaptiveSampling);
+        ImGui::InputFloat("Adaptive Threshold##RenderSettings", &rs.adaptiveThreshold, 0.01f, 0.05f, "%.3f");
     }
     void SceneView::ambientSetting() {
         auto& as = manager.renderSettingsManager.ambientSettings;
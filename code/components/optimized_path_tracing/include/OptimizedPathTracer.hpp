@@ -8,7 +8,7 @@
 #include "intersections/HitRecord.hpp"
 
 #include "shaders/ShaderCreator.hpp"
-#include "BVH.hpp"
+#include "accel/SceneAccel.hpp"
 
 #include <tuple>
 namespace OptimizedPathTracer
@@ -23,12 +23,21 @@ namespace OptimizedPathTracer
         SharedScene spScene;
         Scene& scene;
 
-        SharedBVHTree bvhTree = nullptr;
+        Accel::SharedSceneAccel accel = nullptr;  //场景的两层BVH
 
         unsigned int width;
         unsigned int height;
         unsigned int depth;     //最大的trace递归数目
         unsigned int samples; //采样的光线数
+        unsigned int seed;  //随机数种子, 与像素和采样序号一起决定每个采样的随机数流
+        SampleMethod sampleMethod;
+        unsigned int packetSize;    //主光线与阴影光线成包遍历时每包的光线数, 1为逐条遍历
+        int packetWidth;    //一个光线包覆盖的像素块的宽和高
+        int packetHeight;
+        bool adaptive;      //按像素的相对误差分配采样
+        float adaptiveThreshold;
+        vector<unsigned int> pixelSamples;  //自适应采样时每个像素实际用到的采样数, 按输出图像的下标存放
+        vector<float> pixelErrors;          //自适应采样结束时每个像素的相对误差
 
         using SCam = OptimizedPathTracer::Camera;
         SCam camera;
@@ -44,7 +53,14 @@ namespace OptimizedPathTracer
             height = scene.renderOption.height;
             depth = scene.renderOption.depth;
             samples = scene.renderOption.samplesPerPixel;
-            //this->bvhTree = make_shared<BVHTree>(spScene);
+            seed = scene.renderOption.randomSeed;
+            sampleMethod = scene.renderOption.sampleMethod;
+            packetSize = scene.renderOption.rayPacketSize;
+            if (packetSize != 4 && packetSize != 8 && packetSize != 16) packetSize = 1;
+            packetWidth = packetSize == 4 ? 2 : 4;  //2x2, 4x2, 4x4的像素块
+            packetHeight = packetSize / packetWidth;
+            adaptive = scene.renderOption.adaptiveSampling;
+            adaptiveThreshold = scene.renderOption.adaptiveThreshold;
         }
         ~OptimizedPathTracerRenderer() = default;
 
@@ -54,14 +70,36 @@ namespace OptimizedPathTracer
 
     private:
         void renderTask(RGBA* pixels, int width, int height, int off, int step);
+        void renderPacketTask(RGBA* pixels, int width, int height, int off, int step);
+        void renderAdaptiveTask(RGBA* pixels, int width, int height, int off, int step);
+        void logAdaptiveSampling();
+
+        // 面光源上的一个采样点, 以及从交点射向它的阴影光线是否未被遮挡
+        struct LightSample
+        {
+            Vec3 point;
+            Vec3 normal;
+            bool visible;
+            int light;      //选中的面光源, 没有可采样的光源时为-1
+        };
+        vector<float> lightCdf;     //按功率选取面光源的累积分布, 未归一化
 
         RGB gamma(const RGB& rgb);
-        tuple<Vec3, Vec3> sampleOnlight(const AreaLight& light);
+        tuple<Vec3, Vec3> sampleOnlight(const Accel::AreaLightRecord& light);
         RGB trace(const Ray& ray, int currDepth);
-        RGB OptTrace(const Ray& ray, int currDepth);  //质量最优的采样算法，16采样率下结果可媲美普通的2048采样率
+        LightSample sampleLights();
+        float lightPdf(int light, const Vec3& from, const Vec3& point);
+        //质量最优的采样算法，16采样率下结果可媲美普通的2048采样率; bsdfPdf为产生ray的BSDF采样的pdf, 主光线与镜面散射为0
+        RGB OptTrace(const Ray& ray, int currDepth, float bsdfPdf = 0.f);
+        //OptTrace中求得交点之后的着色; lightSample不为空时, 直接光照使用已做过遮挡查询的光源采样
+        RGB OptShade(const Ray& ray, const HitRecord& hitObject, int currDepth, const LightSample* lightSample, float bsdfPdf = 0.f);
+        RGB shadeBSDF(const Ray& ray, const HitRecord& hitObject, const Shader& shader, int currDepth, const LightSample* lightSample, float continueProb);
         RGB ProbablityTrace(const Ray& ray, int currDepth); //质量与速度的折中算法，16采样率下结果可媲美普通的1024采样率，但速度比OptTrace快1倍
         HitRecord closestHitObject(const Ray& r);
-        tuple<float, Vec3> closestHitLight(const Ray& r);
+        bool occluded(const Ray& r, float tMax);
+        tuple<float, Vec3, int> closestHitLight(const Ray& r);
+        vector<Ray> primaryRayGrid(int gridSize);
+        vector<Ray> primaryRayPackets(int gridSize);
         
     };
 }
@@ -7,7 +7,7 @@
 namespace OptimizedPathTracer
 {
     using namespace NRenderer;
-    // 由局部坐标转换为世界坐标
+    // 由局部坐标转换为世界坐标, Mesh除外
     class VertexTransformer
     {
     private:
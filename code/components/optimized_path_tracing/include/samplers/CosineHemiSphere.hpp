@@ -0,0 +1,26 @@
+#pragma once
+#ifndef __COSINE_HEMI_SPHERE_HPP__
+#define __COSINE_HEMI_SPHERE_HPP__
+
+#include "Sampler3d.hpp"
+#include "UniformInCircle.hpp"
+
+namespace OptimizedPathTracer
+{
+    using namespace std;
+    class CosineHemiSphere final : public Sampler3d  //按cos加权在上半球采样, pdf = cos(theta)/pi
+    {
+    public:
+        CosineHemiSphere() = default;
+
+        Vec3 sample3d() override {
+            //Malley方法: 在单位圆盘上均匀采样后投影到半球面, 投影后的密度正比于cos(theta)
+            UniformInCircle disk{};
+            auto d = disk.sample2d();
+            float z = sqrt(std::max(0.f, 1 - d.x*d.x - d.y*d.y));
+            return { d.x, d.y, z };
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+#ifndef __RANDOM_HPP__
+#define __RANDOM_HPP__
+
+#include "accel/SampleStream.hpp"
+
+namespace OptimizedPathTracer
+{
+    using NRenderer::Vec2;
+    using SampleMethod = NRenderer::RenderOption::SampleMethod;
+    using Accel::SampleStream;
+
+    class RandomStream
+    {
+    public:
+        // 当前线程正在计算的采样
+        static SampleStream& current() {
+            thread_local SampleStream stream{};
+            return stream;
+        }
+
+        static void begin(uint32_t x, uint32_t y, uint32_t sampleIndex, uint32_t seed, SampleMethod method) {
+            current().begin(x, y, sampleIndex, seed, method);
+        }
+    };
+}
+
+#endif
@@ -3,6 +3,7 @@
 #define __SAMPLER_INSTANCE_HPP__
 
 #include "HemiSphere.hpp"
+#include "CosineHemiSphere.hpp"
 #include "Marsaglia.hpp"
 #include "UniformSampler.hpp"
 #include "UniformInCircle.hpp"
@@ -16,7 +17,7 @@ namespace OptimizedPathTracer
             is_base_of<Sampler1d, T>::value ||
             is_base_of<Sampler2d, T>::value ||
             is_base_of<Sampler3d, T>::value, "Not a sampler type.");
-        thread_local static T t{};
+        static T t{};   //采样器没有状态, 各线程共用一个实例
         return t;
     }
 }
@@ -12,9 +12,15 @@ namespace OptimizedPathTracer
         Vec3 absorbed; 
         float eta; 
         float k;
+        Vec3 reflectRatio(const Vec3& wo, const Vec3& normal) const;
     public:
         Glossy(Material& material, vector<Texture>& textures);
         Scattered shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const;
+
+        bool hasBSDF() const override { return true; }
+        BSDFSample sample(const Vec3& wo, const Vec3& normal) const override;
+        Vec3 eval(const Vec3& wo, const Vec3& wi, const Vec3& normal) const override;
+        float pdf(const Vec3& wo, const Vec3& wi, const Vec3& normal) const override;
     };
     
 }
@@ -0,0 +1,36 @@
+#pragma once
+#ifndef __PHONG_LOBE_HPP__
+#define __PHONG_LOBE_HPP__
+
+#include "geometry/vec.hpp"
+#include "samplers/SamplerInstance.hpp"
+#include "Onb.hpp"
+
+namespace OptimizedPathTracer
+{
+    // 绕镜面反射方向的Phong波瓣, pdf = (n+1)/(2pi) * cos^n(alpha), alpha为与反射方向的夹角
+    // 指数50时波瓣的平均cos(alpha)约为0.98, 与原先normalize(mix(反射方向, 半球随机方向, 0.2))的散布相当
+    namespace PhongLobe
+    {
+        constexpr float EXPONENT = 50.f;
+        constexpr float INV_2PI = 0.15915494309189535f;
+
+        inline Vec3 sample(const Vec3& axis) {
+            auto r = defaultSamplerInstance<UniformInSquare>().sample2d();
+            float u = (r.x + 1) * 0.5f, v = (r.y + 1) * 0.5f;
+            float cosAlpha = std::pow(1 - u, 1.f / (EXPONENT + 1));   //1-u在(0, 1]内, 避免pow(0, x)
+            float sinAlpha = std::sqrt(std::max(0.f, 1 - cosAlpha*cosAlpha));
+            float phi = 2 * 3.14159265358979f * v;
+            Onb onb{axis};
+            return glm::normalize(onb.local({ std::cos(phi)*sinAlpha, std::sin(phi)*sinAlpha, cosAlpha }));
+        }
+
+        inline float pdf(const Vec3& axis, const Vec3& wi) {
+            float cosAlpha = glm::dot(axis, wi);
+            if (cosAlpha <= 0) return 0.f;
+            return (EXPONENT + 1) * INV_2PI * std::pow(cosAlpha, EXPONENT);
+        }
+    }
+}
+
+#endif
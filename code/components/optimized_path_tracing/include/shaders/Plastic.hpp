@@ -12,9 +12,23 @@ namespace OptimizedPathTracer
         Vec3 albedo; //漫反射
         Vec3 specularColor; //镜面反射
         float ior; //折射率
+        struct Lobes
+        {
+            Vec3 N;             //朝向wo一侧的法线
+            Vec3 reflectRatio;
+            Vec3 refractRatio;
+            Vec3 refractDir;
+            float reflectProb;
+        };
+        Lobes lobes(const Vec3& wo, const Vec3& normal) const;
     public:
         Plastic(Material& material, vector<Texture>& textures);
         Scattered shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const;
+
+        bool hasBSDF() const override { return true; }
+        BSDFSample sample(const Vec3& wo, const Vec3& normal) const override;
+        Vec3 eval(const Vec3& wo, const Vec3& wi, const Vec3& normal) const override;
+        float pdf(const Vec3& wo, const Vec3& wi, const Vec3& normal) const override;
     };
 }
 
@@ -15,6 +15,14 @@ namespace OptimizedPathTracer
         Ray refractionDir = {};
         Vec3 refractRatio = {};
     };
+
+    struct BSDFSample   //按BSDF重要性采样得到的入射方向
+    {
+        Vec3 wi = {};       //指向光线来源的方向
+        Vec3 f = {};        //BSDF值, 不含cos项
+        float pdf = {0.f};  //wi的立体角概率密度, 镜面反射等delta分布为0
+        bool delta = false; //为true时wi是镜面方向, f直接是该方向的权重
+    };
     
 }
 
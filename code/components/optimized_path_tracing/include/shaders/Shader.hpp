@@ -26,6 +26,13 @@ namespace OptimizedPathTracer
             , textureBuffer         (textures)
         {}
         virtual Scattered shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const = 0;
+
+        // BSDF接口, wo指向观察者, wi指向光线来源, 都是单位向量
+        // 只有能给出解析pdf的材质才重写这三个函数, 其余材质仍然通过shade追踪
+        virtual bool hasBSDF() const { return false; }
+        virtual BSDFSample sample(const Vec3& wo, const Vec3& normal) const { return {}; }
+        virtual Vec3 eval(const Vec3& wo, const Vec3& wi, const Vec3& normal) const { return Vec3{0}; }
+        virtual float pdf(const Vec3& wo, const Vec3& wi, const Vec3& normal) const { return 0.f; }
     };
     SHARE(Shader);
 }
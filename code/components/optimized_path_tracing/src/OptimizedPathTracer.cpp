@@ -13,6 +13,10 @@ namespace OptimizedPathTracer
     return std::exp(-(x * x) / (2 * sigma * sigma));
     }
 
+    static float luminance(const Vec3& c) {
+        return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+    }
+
     void bilateralFilter(RGBA* pixels, int width, int height){ //尝试使用双边滤波来去噪，但是效果不是很好
         float sigmaSpatial = 16.0f;
         float sigmaRange = 0.2f;
@@ -67,6 +71,7 @@ namespace OptimizedPathTracer
             for (int j=0; j<width; j++) {
                 Vec3 color{0, 0, 0};
                 for (int k=0; k < samples; k++) {
+                    RandomStream::begin(j, i, k, seed, sampleMethod);
                     auto r = defaultSamplerInstance<UniformInSquare>().sample2d();
                     float rx = r.x;
                     float ry = r.y;
@@ -74,6 +79,7 @@ namespace OptimizedPathTracer
                     float y = (float(i)+ry)/float(height); //随机采样的光线方向
                     auto ray = camera.shoot(x, y); //打出光线
                     color += OptTrace(ray, 0); //路径追踪渲染
+                    Accel::Stats::add(Accel::Stats::Counter::PATHS);
                 }
                 color /= samples; //平均
                 color = gamma(color);
@@ -83,7 +89,173 @@ namespace OptimizedPathTracer
         //bilateralFilter(pixels, width, height);
     }
 
+    //自适应采样每一批的采样数, 首批也是这么多
+    static unsigned int adaptiveBatch(unsigned int samples) {
+        return std::max(1u, std::min(samples, std::max(4u, samples / 4)));
+    }
+
+    //自适应采样: 先给每个像素一批采样, 之后每一轮只给相对误差仍高于阈值的像素追加一批, 误差大的像素优先,
+    //直到用完本线程的预算(所负责的像素数 * samples). 各线程负责交错的行, 预算互不共享, 不需要同步
+    void OptimizedPathTracerRenderer::renderAdaptiveTask(RGBA* pixels, int width, int height, int off, int step) {
+        struct PixelEstimate
+        {
+            Vec3 sum{0};
+            float mean = 0;     //亮度的均值与平方差之和(Welford)
+            float m2 = 0;
+            unsigned int n = 0;
+        };
+        //亮度均值的相对标准误差, 分母加上一个小量, 全黑且没有方差的背景像素误差为0
+        auto relativeError = [](const PixelEstimate& e) {
+            if (e.n < 2) return FLOAT_INF;
+            return std::sqrt(e.m2 / float(e.n - 1) / float(e.n)) / (e.mean + 0.01f);
+        };
+
+        vector<int> rows;
+        for (int i = off; i < height; i += step) rows.push_back(i);
+        vector<PixelEstimate> estimates(rows.size() * width);
+        const unsigned int batch = adaptiveBatch(samples);
+        int64_t budget = int64_t(samples) * int64_t(estimates.size());
+
+        auto addSamples = [&](int p, unsigned int count) {
+            int i = rows[p / width], j = p % width;
+            auto& e = estimates[p];
+            for (unsigned int c = 0; c < count; c++) {
+                RandomStream::begin(j, i, e.n, seed, sampleMethod);    //追加的采样接着之前的采样序号
+                auto r = defaultSamplerInstance<UniformInSquare>().sample2d();
+                float x = (float(j)+r.x)/float(width);
+                float y = (float(i)+r.y)/float(height);
+                Vec3 color = OptTrace(camera.shoot(x, y), 0);
+                e.sum += color;
+                float l = luminance(color);
+                e.n++;
+                float delta = l - e.mean;
+                e.mean += delta / float(e.n);
+                e.m2 += delta * (l - e.mean);
+            }
+            Accel::Stats::add(Accel::Stats::Counter::PATHS, count);
+            budget -= count;
+        };
+
+        for (int p = 0; p < int(estimates.size()); p++) addSamples(p, batch);
+        vector<pair<float, int>> active;
+        while (budget > 0) {
+            active.clear();
+            for (int p = 0; p < int(estimates.size()); p++) {
+                float err = relativeError(estimates[p]);
+                if (err > adaptiveThreshold) active.push_back({err, p});
+            }
+            if (active.empty()) break;
+            sort(active.begin(), active.end(), greater<>());
+            for (auto& [err, p] : active) {
+                if (budget <= 0) break;
+                addSamples(p, unsigned(std::min<int64_t>(batch, budget)));
+            }
+        }
+
+        for (int p = 0; p < int(estimates.size()); p++) {
+            int i = rows[p / width], j = p % width;
+            auto& e = estimates[p];
+            int index = (height-i-1)*width+j;
+            pixels[index] = {gamma(e.sum / float(e.n)), 1};
+            pixelSamples[index] = e.n;
+            pixelErrors[index] = relativeError(e);
+        }
+    }
+
+    //报告一直在追加采样的像素: 超过首批采样的像素数, 仍未收敛的像素数, 以及采样最多的几个像素
+    void OptimizedPathTracerRenderer::logAdaptiveSampling() {
+        const unsigned int batch = adaptiveBatch(samples);
+        int refined = 0, unconverged = 0;
+        int64_t total = 0;
+        vector<int> order;
+        for (int p = 0; p < int(pixelSamples.size()); p++) {
+            total += pixelSamples[p];
+            if (pixelSamples[p] > batch) {
+                refined++;
+                order.push_back(p);
+            }
+            if (pixelErrors[p] > adaptiveThreshold) unconverged++;
+        }
+        int top = std::min(int(order.size()), 8);
+        partial_sort(order.begin(), order.begin() + top, order.end(), [&](int a, int b) { return pixelSamples[a] > pixelSamples[b]; });
+        string msg = "Adaptive sampling: " + to_string(refined) + "/" + to_string(pixelSamples.size())
+            + " pixels received extra samples, " + to_string(unconverged) + " still above threshold "
+            + to_string(adaptiveThreshold) + ", average " + to_string(double(total) / double(std::max<size_t>(pixelSamples.size(), 1))) + " spp";
+        getServer().logger.log(msg);
+        for (int n = 0; n < top; n++) {
+            int p = order[n];
+            int y = int(height) - 1 - p / int(width);   //输出图像按行上下翻转存放, 换回渲染时的像素坐标
+            getServer().logger.log("  pixel (" + to_string(p % width) + ", " + to_string(y) + "): "
+                + to_string(pixelSamples[p]) + " spp, relative error " + to_string(pixelErrors[p]));
+        }
+    }
+
+    //成包渲染: 同一像素块中各像素的同一次采样组成一个光线包一起求交,
+    //漫反射交点射向面光源的阴影光线也成包做遮挡查询, 之后的弹射仍逐条追踪
+    void OptimizedPathTracerRenderer::renderPacketTask(RGBA* pixels, int width, int height, int off, int step) {
+        constexpr int MAX_PACKET_SIZE = Intersection::MAX_PACKET_SIZE;
+        Ray rays[MAX_PACKET_SIZE];
+        HitRecord hits[MAX_PACKET_SIZE];
+        LightSample lightSamples[MAX_PACKET_SIZE];
+        Ray shadowRays[MAX_PACKET_SIZE];
+        float shadowTMax[MAX_PACKET_SIZE];
+        bool shadowOccluded[MAX_PACKET_SIZE];
+        int shadowOwner[MAX_PACKET_SIZE];  //阴影光线对应的主光线
+        int pixelI[MAX_PACKET_SIZE];
+        int pixelJ[MAX_PACKET_SIZE];
+        SampleStream streams[MAX_PACKET_SIZE];    //包中每个像素各自的随机数流, 轮流装入当前线程
+        auto& rng = RandomStream::current();
+        for (int bi = off * packetHeight; bi < height; bi += step * packetHeight) {
+            for (int bj = 0; bj < width; bj += packetWidth) {
+                int count = 0;  //图像边缘的块可能不满
+                for (int i = bi; i < min(bi + packetHeight, height); i++) {
+                    for (int j = bj; j < min(bj + packetWidth, width); j++) {
+                        pixelI[count] = i;
+                        pixelJ[count++] = j;
+                    }
+                }
+                Vec3 color[MAX_PACKET_SIZE] = {};
+                for (int k = 0; k < samples; k++) {
+                    for (int n = 0; n < count; n++) {
+                        RandomStream::begin(pixelJ[n], pixelI[n], k, seed, sampleMethod);
+                        auto r = defaultSamplerInstance<UniformInSquare>().sample2d();
+                        float x = (float(pixelJ[n]) + r.x)/float(width);
+                        float y = (float(pixelI[n]) + r.y)/float(height);
+                        rays[n] = camera.shoot(x, y);
+                        streams[n] = rng;
+                    }
+                    accel->closestHitPacket(rays, count, 0.000001, FLOAT_INF, hits);
+                    Accel::Stats::add(Accel::Stats::Counter::PATHS, count);
+                    int shadowCount = 0;
+                    for (int n = 0; n < count; n++) {
+                        if (!hits[n] || !shaderPrograms[hits[n]->material.index()]->hasBSDF()) continue;
+                        rng = streams[n];
+                        lightSamples[n] = sampleLights();
+                        streams[n] = rng;
+                        if (lightSamples[n].light < 0) continue;
+                        Vec3 toLight = lightSamples[n].point - hits[n]->hitPoint;
+                        shadowTMax[shadowCount] = glm::length(toLight);
+                        shadowRays[shadowCount] = Ray{hits[n]->hitPoint, toLight / shadowTMax[shadowCount]};
+                        shadowOwner[shadowCount++] = n;
+                    }
+                    accel->occludedPacket(shadowRays, shadowCount, 0.000001, shadowTMax, shadowOccluded);
+                    for (int s = 0; s < shadowCount; s++) lightSamples[shadowOwner[s]].visible = !shadowOccluded[s];
+                    for (int n = 0; n < count; n++) {
+                        bool hasBSDF = hits[n] && shaderPrograms[hits[n]->material.index()]->hasBSDF();
+                        rng = streams[n];
+                        color[n] += OptShade(rays[n], hits[n], 0, hasBSDF ? &lightSamples[n] : nullptr);
+                    }
+                }
+                for (int n = 0; n < count; n++) {
+                    auto c = gamma(color[n] / float(samples));
+                    pixels[(height-pixelI[n]-1)*width+pixelJ[n]] = {c, 1};
+                }
+            }
+        }
+    }
+
     auto OptimizedPathTracerRenderer::render() -> RenderResult {
+        Accel::Stats::reset();  //其他渲染组件留下的计数不计入本次渲染
         // shaders
         shaderPrograms.clear();
         ShaderCreator shaderCreator{};
@@ -97,31 +269,70 @@ namespace OptimizedPathTracer
         VertexTransformer vertexTransformer{};
         vertexTransformer.exec(spScene);
 
-        this->bvhTree = make_shared<BVHTree>(spScene);
-        //bvhTree->printTree(bvhTree->root, 0);
-
-        // int nodeNum = bvhTree->aabbs.size();
-        // cout<<"nodeNum: "<<nodeNum<<endl;
+        accel = make_shared<Accel::SceneAccel>(spScene);
+        lightCdf.clear();
+        float lightPower = 0;
+        for (auto& light : accel->areaLights()) {
+            lightPower += luminance(light.radiance) * light.area;
+            lightCdf.push_back(lightPower);
+        }
 
+        if (adaptive) {
+            pixelSamples.assign(width*height, 0);
+            pixelErrors.assign(width*height, 0.f);
+        }
         const auto taskNums = 16;
         thread t[taskNums];
         for (int i=0; i < taskNums; i++) {
-            t[i] = thread(&OptimizedPathTracerRenderer::renderTask,
-                this, pixels, width, height, i, taskNums); //多线程渲染
+            auto task = adaptive ? &OptimizedPathTracerRenderer::renderAdaptiveTask
+                : packetSize > 1 ? &OptimizedPathTracerRenderer::renderPacketTask : &OptimizedPathTracerRenderer::renderTask;
+            t[i] = thread(task, this, pixels, width, height, i, taskNums); //多线程渲染
         }
         for(int i=0; i < taskNums; i++) {
             t[i].join();
         }
         getServer().logger.log("Done...");
 
-        int64_t totalIntersections = Intersection::getIntersectionCount();
-        cout << "BVH intersection calls: " << totalIntersections <<"with Sample: "<<samples<< std::endl;
-        Intersection::resetIntersectionCount();
+        accel->logStats();
+        if (adaptive) logAdaptiveSampling();
+        //额外的遍历速度比较会再追踪65536条主光线, 只在渲染选项中开启时进行
+        if (scene.renderOption.bvhBenchmark) {
+            accel->logLayoutSpeed(primaryRayGrid(256));
+            if (packetSize > 1) accel->logPacketSpeed(primaryRayPackets(256), packetSize);
+        }
 
 
         return {pixels, width, height};
     }
 
+    // 穿过每个网格中心的主光线
+    vector<Ray> OptimizedPathTracerRenderer::primaryRayGrid(int gridSize) {
+        vector<Ray> rays;
+        rays.reserve(gridSize * gridSize);
+        for (int i = 0; i < gridSize; i++) {
+            for (int j = 0; j < gridSize; j++) {
+                rays.push_back(camera.shoot((float(j) + 0.5f) / gridSize, (float(i) + 0.5f) / gridSize));
+            }
+        }
+        return rays;
+    }
+
+    // 与primaryRayGrid相同的主光线, 按光线包的像素块依次排列
+    vector<Ray> OptimizedPathTracerRenderer::primaryRayPackets(int gridSize) {
+        vector<Ray> rays;
+        rays.reserve(gridSize * gridSize);
+        for (int bi = 0; bi < gridSize; bi += packetHeight) {
+            for (int bj = 0; bj < gridSize; bj += packetWidth) {
+                for (int i = bi; i < min(bi + packetHeight, gridSize); i++) {
+                    for (int j = bj; j < min(bj + packetWidth, gridSize); j++) {
+                        rays.push_back(camera.shoot((float(j) + 0.5f) / gridSize, (float(i) + 0.5f) / gridSize));
+                    }
+                }
+            }
+        }
+        return rays;
+    }
+
     void OptimizedPathTracerRenderer::release(const RenderResult& r) {
         auto [p, w, h] = r;
         delete[] p;
@@ -130,7 +341,7 @@ namespace OptimizedPathTracer
     HitRecord OptimizedPathTracerRenderer::closestHitObject(const Ray& r) {
         HitRecord closestHit = nullopt;
         float closest = FLOAT_INF;
-        auto hitRecord = Intersection::xBVH(r, bvhTree->root, 0.000001, closest); //BVH加速
+        auto hitRecord = accel->closestHit(r, 0.000001, closest);  //BVH加速
         if (hitRecord && hitRecord->t < closest ) {
             closest = hitRecord->t;
             return hitRecord;
@@ -138,34 +349,38 @@ namespace OptimizedPathTracer
         return closestHit; 
     }
     
-    tuple<float, Vec3> OptimizedPathTracerRenderer::closestHitLight(const Ray& r) {
+    bool OptimizedPathTracerRenderer::occluded(const Ray& r, float tMax) {
+        return accel->occluded(r, 0.000001, tMax);
+    }
+    
+    tuple<float, Vec3, int> OptimizedPathTracerRenderer::closestHitLight(const Ray& r) {
         Vec3 v = {};
+        int index = -1;
         HitRecord closest = getHitRecord(FLOAT_INF, {}, {}, {});  //使用INF初始化,表示最近交点在无穷远处
         //Cornell Box中只有一个面光源
-        for (auto& a : scene.areaLightBuffer) {
-            auto hitRecord = Intersection::xAreaLight(r, a, 0.000001, closest->t); //计算光线r与区域光源a的交点，得到一个HitRecord类型的对象hitRecord
+        auto& lights = accel->areaLights();
+        for (int i = 0; i < int(lights.size()); i++) {
+            auto hitRecord = Intersection::xAreaLight(r, lights[i], 0.000001, closest->t); //计算光线r与区域光源的交点，得到一个HitRecord类型的对象hitRecord
             if (hitRecord && closest->t > hitRecord->t) { //ray r 和区域光有交点
                 closest = hitRecord;
-                v = a.radiance; //radianc相当于发出的光线
+                v = lights[i].radiance; //radianc相当于发出的光线
+                index = i;
             }
         }
         //迭代之后,找到光线r与所有面光源的最近交点
-        return { closest->t, v };
+        return { closest->t, v, index };
     }
 
-    tuple<Vec3, Vec3> OptimizedPathTracerRenderer::sampleOnlight(const AreaLight& light){
-        Vec3 p = light.position;
-        Vec3 u = light.u;
-        Vec3 v = light.v;
-        Vec3 normal = glm::normalize(glm::cross(u, v));
-        Vec3 samplePoint = p + u * defaultSamplerInstance<UniformSampler>().sample1d() + v * defaultSamplerInstance<UniformSampler>().sample1d();
-        return {samplePoint, normal};
+    tuple<Vec3, Vec3> OptimizedPathTracerRenderer::sampleOnlight(const Accel::AreaLightRecord& light){
+        auto r = defaultSamplerInstance<UniformInSquare>().sample2d();    //光源上的两维作为一组联合分层
+        Vec3 samplePoint = light.position + light.u * ((r.x + 1) * 0.5f) + light.v * ((r.y + 1) * 0.5f);
+        return {samplePoint, light.normal};
     }
 
     RGB OptimizedPathTracerRenderer::trace(const Ray& r, int currDepth) {
         if (currDepth == depth) return scene.ambient.constant; //递归数目达到depth
         auto hitObject = closestHitObject(r);   //光线最近的射中物体
-        auto [ t, emitted ] = closestHitLight(r);   
+        auto [ t, emitted, lightIndex ] = closestHitLight(r);   
         // hit object
         if (hitObject && hitObject->t < t) { //hitObject在相机和面光源之间
             auto mtlHandle = hitObject->material;
@@ -229,46 +444,51 @@ namespace OptimizedPathTracer
         }
     }
 
-    RGB OptimizedPathTracerRenderer::OptTrace(const Ray& r, int currDepth){
+    // 多重重要性采样的幂启发式(beta = 2)
+    static float powerHeuristic(float pdfA, float pdfB) {
+        float a = pdfA * pdfA, b = pdfB * pdfB;
+        return a + b > 0 ? a / (a + b) : 0.f;
+    }
+
+    // 按功率(亮度 * 面积)选取一个面光源, 再在其上均匀采样一点
+    auto OptimizedPathTracerRenderer::sampleLights() -> LightSample {
+        auto& lights = accel->areaLights();
+        if (lights.empty() || lightCdf.back() <= 0) return { {}, {}, false, -1 };
+        float u = defaultSamplerInstance<UniformSampler>().sample1d() * lightCdf.back();
+        int i = int(upper_bound(lightCdf.begin(), lightCdf.end(), u) - lightCdf.begin());
+        i = std::min(i, int(lights.size()) - 1);
+        auto [samplePoint, normal] = sampleOnlight(lights[i]);
+        return { samplePoint, normal, true, i };
+    }
+
+    // 用sampleLights从from采到光源i上point的立体角概率密度
+    float OptimizedPathTracerRenderer::lightPdf(int i, const Vec3& from, const Vec3& point) {
+        auto& light = accel->areaLights()[i];
+        Vec3 d = point - from;
+        float distance2 = glm::dot(d, d);
+        float cosTheta = -glm::dot(d, light.normal) / std::sqrt(distance2);
+        if (cosTheta < 0.0001f) return 0.f;     //光源只向法线一侧发光
+        float select = (lightCdf[i] - (i > 0 ? lightCdf[i-1] : 0.f)) / lightCdf.back();
+        return select * distance2 / (cosTheta * light.area);
+    }
+
+    RGB OptimizedPathTracerRenderer::OptTrace(const Ray& r, int currDepth, float bsdfPdf){
         if (currDepth == depth) return scene.ambient.constant; //递归数目达到depth
-        auto hitObject = closestHitObject(r);   //光线最近的射中物体
-        auto [ t, emitted ] = closestHitLight(r);   
+        return OptShade(r, closestHitObject(r), currDepth, nullptr, bsdfPdf);   //光线最近的射中物体
+    }
+
+    RGB OptimizedPathTracerRenderer::OptShade(const Ray& r, const HitRecord& hitObject, int currDepth, const LightSample* lightSample, float bsdfPdf){
+        if (currDepth == depth) return scene.ambient.constant; //递归数目达到depth
+        auto [ t, emitted, lightIndex ] = closestHitLight(r);   
         // hit object
         if (hitObject && hitObject->t < t) { //hitObject在相机和面光源之间
             auto mtlHandle = hitObject->material;
-            auto scattered = shaderPrograms[mtlHandle.index()]->shade(r, hitObject->hitPoint, hitObject->normal);
-            if(spScene->materials[mtlHandle.index()].type == Material::LAMBERTIAN){
-                auto scatteredRay = scattered.ray;
-                auto attenuation = scattered.attenuation;
-                auto emitted = scattered.emitted;
-
-                auto [samplePoint, normal] = sampleOnlight(scene.areaLightBuffer[0]);
-                Vec3 shadowRayDir = glm::normalize(samplePoint - hitObject->hitPoint);
-                Ray shadowRay{hitObject->hitPoint, shadowRayDir};
-                auto shadowHit = closestHitObject(shadowRay);
-                float distance2Light = glm::length(samplePoint - hitObject->hitPoint);
-                float cosTheta = glm::dot(-shadowRayDir, normal);
-                Vec3 L_dir;
-                auto radiance = scene.areaLightBuffer[0].radiance;  //直接光照
-                if(shadowHit && shadowHit->t < distance2Light || cosTheta < 0.0001){  //如果被遮挡， 或与光源法向量夹角过小
-                    L_dir = Vec3(0.f);
-                }
-                else{
-                    float pdf_light = 1.0f / (glm::length(scene.areaLightBuffer[0].u) * glm::length(scene.areaLightBuffer[0].v)); // 光源pdf, 1/A
-                    float n_dot_in_light = glm::dot(hitObject->normal, shadowRayDir); 
-                    Vec3 directLighting = radiance * n_dot_in_light * cosTheta / (distance2Light * distance2Light * pdf_light);
-                    L_dir = attenuation * directLighting;
-                }
-                
-                auto next = OptTrace(scatteredRay, currDepth+1);
-                if(next == radiance) next = Vec3(0.f);  //如果随机采样追踪的光线直接射到光源上, 避免二次叠加
-                float n_dot_in = glm::dot(hitObject->normal, scatteredRay.direction);
-                float pdf = scattered.pdf;
-                Vec3 L_indir = attenuation * next * n_dot_in / pdf;
-
-                return emitted + L_dir + L_indir;
+            auto& shader = *shaderPrograms[mtlHandle.index()];
+            if(shader.hasBSDF()){
+                return shadeBSDF(r, hitObject, shader, currDepth, lightSample, 1.f);
             }
-            else if(spScene->materials[mtlHandle.index()].type == Material::DIELECTRIC){
+            auto scattered = shader.shade(r, hitObject->hitPoint, hitObject->normal);
+            if(spScene->materials[mtlHandle.index()].type == Material::DIELECTRIC){
                 auto reflect = scattered.ray;
                 auto reflectRatio = scattered.attenuation;
                 auto refract = scattered.refractionDir;
@@ -283,76 +503,68 @@ namespace OptimizedPathTracer
                 auto reflectRGB = reflectRatio == Vec3(0.f) ? RGB(0.f) :OptTrace(reflect, currDepth + 1); 
                 return reflectRGB * reflectRatio;
             }
-            else if(spScene->materials[mtlHandle.index()].type == Material::PLASTIC){
-                auto reflect = scattered.ray;
-                auto reflectRatio = scattered.attenuation;
-                auto refract = scattered.refractionDir;
-                auto refractRatio = scattered.refractRatio;
-                auto reflectRGB = reflectRatio == Vec3(0.f) ? RGB(0.f) :OptTrace(reflect, currDepth + 1); //如果是全透射,则没有反射光线
-                auto refractRGB = refractRatio == Vec3(0.f) ? RGB(0.f) :OptTrace(refract, currDepth + 1);  //如果是全反射,则没有折射光线
-                return reflectRGB * reflectRatio + refractRGB * refractRatio;
-            }
-            else if(spScene->materials[mtlHandle.index()].type == Material::GLOSSY){
-                auto reflect = scattered.ray;
-                auto reflectRatio = scattered.attenuation;
-                auto reflectRGB = reflectRatio == Vec3(0.f) ? RGB(0.f) :OptTrace(reflect, currDepth + 1); 
-                return reflectRGB * reflectRatio;
-            }
             else{
                 return Vec3(0.f);
             }
         }
         // 
-        else if (t != FLOAT_INF) {  //hitObject在面光源,直接返回面光源的激发亮度
-            return emitted;
+        else if (t != FLOAT_INF) {  //hitObject在面光源
+            //主光线与镜面散射之后没有光源采样与之竞争, 直接返回面光源的激发亮度
+            if (bsdfPdf <= 0) return emitted;
+            //上一次BSDF采样射中光源, 与该处的光源采样按MIS权重分配
+            return emitted * powerHeuristic(bsdfPdf, lightPdf(lightIndex, r.origin, r.at(t)));
         }
         else {
             return Vec3{0}; //没有hitObject,也没有面光源
         }
+    }
+
+    // 光源采样与BSDF采样各取一个方向, 按幂启发式合并; BSDF方向以continueProb的概率继续追踪
+    RGB OptimizedPathTracerRenderer::shadeBSDF(const Ray& r, const HitRecord& hitObject, const Shader& shader, int currDepth, const LightSample* lightSample, float continueProb) {
+        Vec3 wo = -glm::normalize(r.direction);
+        const Vec3& hitPoint = hitObject->hitPoint;
+        const Vec3& n = hitObject->normal;
+
+        RGB L_dir{0};
+        auto ls = lightSample ? *lightSample : sampleLights();
+        if (ls.light >= 0) {
+            Vec3 toLight = ls.point - hitPoint;
+            float distance2Light = glm::length(toLight);
+            Vec3 wi = toLight / distance2Light;
+            float pdfLight = lightPdf(ls.light, hitPoint, ls.point);
+            Vec3 f = shader.eval(wo, wi, n);
+            //BSDF为0时不发射阴影光线; 成包渲染时阴影光线已经一起做过遮挡查询
+            if (pdfLight > 0 && f != Vec3(0.f) && (lightSample ? ls.visible : !occluded(Ray{hitPoint, wi}, distance2Light))) {
+                //最后一次弹射的BSDF方向不再追踪, 不会与光源采样竞争, 光源采样取全部权重
+                float weight = currDepth + 1 >= int(depth) ? 1.f : powerHeuristic(pdfLight, shader.pdf(wo, wi, n));
+                L_dir = f * accel->areaLights()[ls.light].radiance * fabs(glm::dot(n, wi)) * weight / pdfLight;
+            }
         }
+
+        if (continueProb < 1.f && defaultSamplerInstance<UniformSampler>().sample1d() >= continueProb) //随机终止
+            return L_dir;
+        auto bsdf = shader.sample(wo, n);
+        Ray next{hitPoint, bsdf.wi};
+        if (bsdf.delta) return L_dir + bsdf.f * OptTrace(next, currDepth+1) / continueProb;   //镜面方向, f即为权重
+        if (bsdf.pdf <= 0) return L_dir;
+        Vec3 L_indir = bsdf.f * OptTrace(next, currDepth+1, bsdf.pdf) * fabs(glm::dot(n, bsdf.wi)) / bsdf.pdf;
+        return L_dir + L_indir / continueProb;
+    }
     
     RGB OptimizedPathTracerRenderer::ProbablityTrace(const Ray& r, int currDepth){
         if (currDepth == depth) return scene.ambient.constant; //递归数目达到depth
         auto hitObject = closestHitObject(r);   //光线最近的射中物体
-        auto [ t, emitted ] = closestHitLight(r);   
+        auto [ t, emitted, lightIndex ] = closestHitLight(r);   
         float stop_prob = 0.85f;
         // hit object
         if (hitObject && hitObject->t < t) { //hitObject在相机和面光源之间
             auto mtlHandle = hitObject->material;
-            auto scattered = shaderPrograms[mtlHandle.index()]->shade(r, hitObject->hitPoint, hitObject->normal);
-            if(spScene->materials[mtlHandle.index()].type == Material::LAMBERTIAN){
-                auto scatteredRay = scattered.ray;
-                auto attenuation = scattered.attenuation;
-                auto emitted = scattered.emitted;
-
-                auto [samplePoint, normal] = sampleOnlight(scene.areaLightBuffer[0]);
-                Vec3 shadowRayDir = glm::normalize(samplePoint - hitObject->hitPoint);
-                Ray shadowRay{hitObject->hitPoint, shadowRayDir};
-                auto shadowHit = closestHitObject(shadowRay);
-                float distance2Light = glm::length(samplePoint - hitObject->hitPoint);
-                float cosTheta = glm::dot(-shadowRayDir, normal);
-                Vec3 L_dir;
-                auto radiance = scene.areaLightBuffer[0].radiance;  //直接光照
-                if(shadowHit && shadowHit->t < distance2Light || cosTheta < 0.0001){  //如果被遮挡， 或与光源法向量夹角过小
-                    L_dir = Vec3(0.f);
-                }
-                else{
-                    float pdf_light = 1.0f / (glm::length(scene.areaLightBuffer[0].u) * glm::length(scene.areaLightBuffer[0].v)); // 光源pdf, 1/A
-                    float n_dot_in_light = glm::dot(hitObject->normal, shadowRayDir); 
-                    Vec3 directLighting = radiance * n_dot_in_light * cosTheta / (distance2Light * distance2Light * pdf_light);
-                    L_dir = attenuation * directLighting;
-                }
-                if(defaultSamplerInstance<UniformSampler>().sample1d() < stop_prob) //随机终止
-                    return emitted + L_dir;
-                auto next = OptTrace(scatteredRay, currDepth+1);
-                if(next == radiance) next = Vec3(0.f);  //如果随机采样追踪的光线直接射到光源上, 避免二次叠加
-                float n_dot_in = glm::dot(hitObject->normal, scatteredRay.direction);
-                float pdf = scattered.pdf;
-                Vec3 L_indir = attenuation * next * n_dot_in / pdf;
-
-                return emitted + L_dir + L_indir/(1-stop_prob);
+            auto& shader = *shaderPrograms[mtlHandle.index()];
+            if(shader.hasBSDF()){
+                return shadeBSDF(r, hitObject, shader, currDepth, nullptr, 1 - stop_prob);
             }
-            else if(spScene->materials[mtlHandle.index()].type == Material::DIELECTRIC){
+            auto scattered = shader.shade(r, hitObject->hitPoint, hitObject->normal);
+            if(spScene->materials[mtlHandle.index()].type == Material::DIELECTRIC){
                 auto reflect = scattered.ray;
                 auto reflectRatio = scattered.attenuation;
                 auto refract = scattered.refractionDir;
@@ -367,21 +579,6 @@ namespace OptimizedPathTracer
                 auto reflectRGB = reflectRatio == Vec3(0.f) ? RGB(0.f) :OptTrace(reflect, currDepth + 1); 
                 return reflectRGB * reflectRatio;
             }
-            else if(spScene->materials[mtlHandle.index()].type == Material::PLASTIC){
-                auto reflect = scattered.ray;
-                auto reflectRatio = scattered.attenuation;
-                auto refract = scattered.refractionDir;
-                auto refractRatio = scattered.refractRatio;
-                auto reflectRGB = reflectRatio == Vec3(0.f) ? RGB(0.f) :OptTrace(reflect, currDepth + 1); //如果是全透射,则没有反射光线
-                auto refractRGB = refractRatio == Vec3(0.f) ? RGB(0.f) :OptTrace(refract, currDepth + 1);  //如果是全反射,则没有折射光线
-                return reflectRGB * reflectRatio + refractRGB * refractRatio;
-            }
-            else if(spScene->materials[mtlHandle.index()].type == Material::GLOSSY){
-                auto reflect = scattered.ray;
-                auto reflectRatio = scattered.attenuation;
-                auto reflectRGB = reflectRatio == Vec3(0.f) ? RGB(0.f) :OptTrace(reflect, currDepth + 1); 
-                return reflectRGB * reflectRatio;
-            }
             else{
                 return Vec3(0.f);
             }
@@ -394,4 +591,4 @@ namespace OptimizedPathTracer
             return Vec3{0}; //没有hitObject,也没有面光源
         }
     }
-}
\ No newline at end of file
+}
@@ -7,7 +7,6 @@ namespace OptimizedPathTracer
         auto& scene = *spScene;
         for (auto& node : scene.nodes) {
             Mat4x4 t{1};
-            Mat4x4 s{1};
             auto& model = spScene->models[node.model];
             t = glm::translate(t, model.translation);
 
@@ -25,14 +24,7 @@ namespace OptimizedPathTracer
                 auto& v = scene.planeBuffer[node.entity].position;
                 v = t*Vec4{v, 1};
             }
-            else if (node.type == Node::Type::MESH) {
-                s = glm::scale(s, model.scale);
-                t = t * s; //??????
-                auto& mesh = scene.meshBuffer[node.entity];
-                for (int i=0; i<mesh.positions.size(); i++) {
-                    mesh.positions[i] = t*Vec4{mesh.positions[i], 1};
-                }
-            }
+            //Mesh保持在物体空间, 由两层BVH中的实例记录变换
         }
     }
 }
\ No newline at end of file
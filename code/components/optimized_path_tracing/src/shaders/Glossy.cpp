@@ -1,5 +1,6 @@
 #include "shaders/Glossy.hpp"
 #include "samplers/SamplerInstance.hpp"
+#include "shaders/PhongLobe.hpp"
 
 #include "Onb.hpp"
 
@@ -22,24 +23,10 @@ namespace OptimizedPathTracer
     }
 
 
-    Scattered Glossy::shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const {
-        Vec3 origin = hitPoint;
-        Vec3 N = glm::normalize(normal); //法向量
-        Vec3 I = glm::normalize(ray.direction);
-        float cosTheta = glm::dot(-I, N);  //入射角cos
-        bool isEntering = cosTheta > 0; //是否从外部射入
-        if (!isEntering) { //如果从内部射入 ,则将法向量取反,并将cosTheta取反
-            N = -N; 
-            cosTheta = glm::dot(-I, N);
-        }
-
-        Vec3 random = defaultSamplerInstance<HemiSphere>().sample3d();
-        Onb onb{normal}; //包含normal的一组正交基
-        Vec3 diffuseDir = glm::normalize(onb.local(random));
-
-        Vec3 reflectDir = glm::reflect(I, N); //镜面反射方向
-
-         Vec3 reflectionDirection = glm::normalize(glm::mix(reflectDir, diffuseDir, 0.2)); //反射方向
+    //菲涅尔反射率, 从内部射入时不反射
+    Vec3 Glossy::reflectRatio(const Vec3& wo, const Vec3& normal) const {
+        float cosTheta = glm::dot(wo, glm::normalize(normal));  //入射角cos
+        if (cosTheta <= 0) return Vec3(0.f);
 
         float k2 = k * k;
         Vec3 etaMinusOne = eta -  Vec3(1.f);
@@ -48,14 +35,42 @@ namespace OptimizedPathTracer
         Vec3 r0 = (etaMinusOne * etaMinusOne + k2) / (etaPlusOne * etaPlusOne + k2);
 
         Vec3 reflectance = r0 + ( Vec3(1.f) - r0) * pow(1.0f - cosTheta, 5.0f);
+        return reflectance * absorbed;
+    }
 
-        Vec3 reflectRatio = isEntering ? reflectance * absorbed : Vec3(0.f); 
-
+    Scattered Glossy::shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const {
+        auto s = sample(-glm::normalize(ray.direction), normal);
+        Vec3 weight = s.pdf > 0 ? s.f * glm::dot(s.wi, glm::normalize(normal)) / s.pdf : Vec3(0.f);
         return {
-            Ray{origin, reflectionDirection}, //反射光线
-            reflectRatio, //反射率
+            Ray{hitPoint, s.wi}, //反射光线
+            weight, //反射率
             Vec3{0}, 
             1
         };
     }
+
+    //在反射方向的Phong波瓣内采样, f取reflectRatio * pdf / cos, 使每个采样的权重恰为反射率
+    BSDFSample Glossy::sample(const Vec3& wo, const Vec3& normal) const {
+        Vec3 N = glm::normalize(normal);
+        Vec3 ratio = reflectRatio(wo, N);
+        if (ratio == Vec3(0.f)) return {};
+        Vec3 wi = PhongLobe::sample(glm::reflect(-wo, N));
+        float cosIn = glm::dot(wi, N);
+        if (cosIn <= 0) return {};     //波瓣落到表面以下的部分被吸收
+        float p = PhongLobe::pdf(glm::reflect(-wo, N), wi);
+        return { wi, ratio * p / cosIn, p };
+    }
+
+    Vec3 Glossy::eval(const Vec3& wo, const Vec3& wi, const Vec3& normal) const {
+        Vec3 N = glm::normalize(normal);
+        float cosIn = glm::dot(wi, N);
+        if (cosIn <= 0) return Vec3(0.f);
+        return reflectRatio(wo, N) * PhongLobe::pdf(glm::reflect(-wo, N), wi) / cosIn;
+    }
+
+    float Glossy::pdf(const Vec3& wo, const Vec3& wi, const Vec3& normal) const {
+        Vec3 N = glm::normalize(normal);
+        if (glm::dot(wo, N) <= 0 || glm::dot(wi, N) <= 0) return 0.f;
+        return PhongLobe::pdf(glm::reflect(-wo, N), wi);
+    }
 }
\ No newline at end of file
@@ -13,21 +13,28 @@ namespace OptimizedPathTracer
         else albedo = {1, 1, 1};
     }
     Scattered Lambertian::shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const { 
-        Vec3 origin = hitPoint;
-        Vec3 random = defaultSamplerInstance<HemiSphere>().sample3d();
+        auto s = sample(-ray.direction, normal);
+        return { //返回散射光线，衰减，自发光，pdf
+            Ray{hitPoint, s.wi},
+            s.f,
+            Vec3{0},
+            s.pdf
+        };
+    }
 
+    BSDFSample Lambertian::sample(const Vec3& wo, const Vec3& normal) const {
+        Vec3 random = defaultSamplerInstance<CosineHemiSphere>().sample3d();
         Onb onb{normal}; //包含normal的一组正交基
-        Vec3 direction = glm::normalize(onb.local(random)); //将随机采样的方向, 与onb线性组合,转换到世界坐标系
-
-        float pdf = 1/(2*PI);  //蒙特卡洛随机采样, 需要除以一个半球的面积,即2pi
+        Vec3 wi = glm::normalize(onb.local(random)); //将随机采样的方向, 与onb线性组合,转换到世界坐标系
+        //按cos加权采样, pdf = cos/pi, 与BRDF的cos项相消, 掠射方向不再浪费采样
+        return { wi, albedo / PI, std::max(random.z, 1e-6f) / PI };
+    }
 
-        auto attenuation = albedo / PI; 
+    Vec3 Lambertian::eval(const Vec3& wo, const Vec3& wi, const Vec3& normal) const {
+        return glm::dot(wi, normal) > 0 ? albedo / PI : Vec3{0};
+    }
 
-        return { //返回散射光线，衰减，自发光，pdf
-            Ray{origin, direction},
-            attenuation,
-            Vec3{0},
-            pdf
-        };
+    float Lambertian::pdf(const Vec3& wo, const Vec3& wi, const Vec3& normal) const {
+        return std::max(glm::dot(wi, normal), 0.f) / PI;
     }
 }
\ No newline at end of file
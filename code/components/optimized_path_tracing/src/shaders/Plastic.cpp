@@ -1,5 +1,6 @@
 #include "shaders/Plastic.hpp"
 #include "samplers/SamplerInstance.hpp"
+#include "shaders/PhongLobe.hpp"
 
 #include "Onb.hpp"
 
@@ -20,53 +21,78 @@ namespace OptimizedPathTracer
         if (ior) this->ior = (*ior).value; // Index of Refraction 折射率
         else this->ior = 1.46f;
     }
-    Scattered Plastic::shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const { 
-        Vec3 origin = hitPoint;
-        Vec3 N = glm::normalize(normal); //法向量
-        Vec3 I = glm::normalize(ray.direction);
-        float cosTheta = glm::dot(-I, N);  //入射角cos
+    //按wo所在一侧翻转法线, 求反射波瓣与折射方向的权重, 以及按权重亮度选择反射波瓣的概率
+    Plastic::Lobes Plastic::lobes(const Vec3& wo, const Vec3& normal) const {
+        Lobes l;
+        l.N = glm::normalize(normal); //法向量
+        float cosTheta = glm::dot(wo, l.N);  //入射角cos
         bool isEntering = cosTheta > 0; //是否从外部射入
         if (!isEntering) { //如果从内部射入 ,则将法向量取反,并将cosTheta取反
-            N = -N; 
-            cosTheta = glm::dot(-I, N);
+            l.N = -l.N;
+            cosTheta = -cosTheta;
         }
-
-        Vec3 random = defaultSamplerInstance<HemiSphere>().sample3d();
-        Onb onb{normal}; //包含normal的一组正交基
-        Vec3 diffuseDir = glm::normalize(onb.local(random));
-
-        Vec3 reflectDir = glm::reflect(I, N); //镜面反射方向
+        l.refractDir = isEntering ? glm::refract(-wo, l.N, 1.f / ior) : glm::refract(-wo, l.N, ior);
 
         float r0 = (1 - ior) / (1 + ior); 
         r0 = r0 * r0; 
-
         float reflectance = r0 + (1 - r0) * std::pow(1 - cosTheta, 5); //Schlick's approximation
 
-        Vec3 reflectionDirection = glm::normalize(glm::mix(reflectDir, diffuseDir, 0.2)); //反射方向
-        Vec3 reflectRatio = reflectance * albedo; //反射率
-
-        Vec3 refractionDirection = isEntering ? glm::refract(I, N, 1.f / ior) : glm::refract(I, N, ior); 
-
-        Vec3 refractRatio = (1 - reflectance) * albedo; //折射率
-
-        if (cosTheta < 0.01f) { //全反射, 没有折射
-            reflectRatio = albedo;  
-            refractionDirection = Vec3(0.f);
-            refractRatio = Vec3(0.f);
+        l.reflectRatio = reflectance * albedo; //反射率
+        l.refractRatio = (1 - reflectance) * albedo; //折射率
+        if (cosTheta < 0.01f || l.refractDir == Vec3(0.f)) { //全反射, 没有折射
+            l.reflectRatio = albedo;
+            l.refractRatio = Vec3(0.f);
         }
         else if(cosTheta > 0.99f) { //全透射
-            reflectRatio = Vec3(0.f);
-            reflectionDirection = Vec3(0.f);
-            refractRatio = albedo;
+            l.reflectRatio = Vec3(0.f);
+            l.refractRatio = albedo;
         }
+        float reflectSum = l.reflectRatio.r + l.reflectRatio.g + l.reflectRatio.b;
+        float refractSum = l.refractRatio.r + l.refractRatio.g + l.refractRatio.b;
+        l.reflectProb = reflectSum + refractSum > 0 ? reflectSum / (reflectSum + refractSum) : 0.f;
+        return l;
+    }
+
+    Scattered Plastic::shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const { 
+        Vec3 I = glm::normalize(ray.direction);
+        auto l = lobes(-I, normal);
+        Vec3 reflectionDirection = l.reflectRatio == Vec3(0.f) ? Vec3(0.f) : PhongLobe::sample(glm::reflect(I, l.N)); //反射方向
+        Vec3 refractionDirection = l.refractRatio == Vec3(0.f) ? Vec3(0.f) : l.refractDir;
         return {
-            Ray{origin, reflectionDirection}, //反射光线
-            reflectRatio, //反射率
+            Ray{hitPoint, reflectionDirection}, //反射光线
+            l.reflectRatio, //反射率
             Vec3{0}, 
             1,
-            Ray{origin, refractionDirection}, //折射光线
-            refractRatio //折射率
+            Ray{hitPoint, refractionDirection}, //折射光线
+            l.refractRatio //折射率
         };
-        
+    }
+
+    //按概率选择反射波瓣或折射方向, 选中的一支除以被选中的概率
+    BSDFSample Plastic::sample(const Vec3& wo, const Vec3& normal) const {
+        auto l = lobes(wo, normal);
+        if (l.reflectProb <= 0 && l.refractRatio == Vec3(0.f)) return {};
+        if (defaultSamplerInstance<UniformSampler>().sample1d() >= l.reflectProb) {
+            return { l.refractDir, l.refractRatio / (1 - l.reflectProb), 0.f, true };
+        }
+        Vec3 axis = glm::reflect(-wo, l.N);
+        Vec3 wi = PhongLobe::sample(axis);
+        float cosIn = glm::dot(wi, l.N);
+        if (cosIn <= 0) return {};  //波瓣落到表面以下的部分被吸收
+        float p = PhongLobe::pdf(axis, wi);
+        return { wi, l.reflectRatio * p / cosIn, l.reflectProb * p };
+    }
+
+    Vec3 Plastic::eval(const Vec3& wo, const Vec3& wi, const Vec3& normal) const {
+        auto l = lobes(wo, normal);
+        float cosIn = glm::dot(wi, l.N);
+        if (cosIn <= 0) return Vec3(0.f);
+        return l.reflectRatio * PhongLobe::pdf(glm::reflect(-wo, l.N), wi) / cosIn;
+    }
+
+    float Plastic::pdf(const Vec3& wo, const Vec3& wi, const Vec3& normal) const {
+        auto l = lobes(wo, normal);
+        if (glm::dot(wi, l.N) <= 0) return 0.f;
+        return l.reflectProb * PhongLobe::pdf(glm::reflect(-wo, l.N), wi);
     }
 }
\ No newline at end of file
@@ -9,7 +9,7 @@
 
 #include "shaders/ShaderCreator.hpp"
 #include "KDTree.hpp"
-#include "BVH.hpp"
+#include "accel/SceneAccel.hpp"
 
 #include <tuple>
 namespace PhotonMapper
@@ -27,6 +27,8 @@ namespace PhotonMapper
         unsigned int height;
         unsigned int depth;     //最大的trace递归数目
         unsigned int samples; //采样的光线数
+        unsigned int seed;  //随机数种子, 与像素和采样序号一起决定每个采样的随机数流
+        SampleMethod sampleMethod;
         unsigned int photonNum; //光子数目
         unsigned int samplePhotonNum;
 
@@ -36,7 +38,7 @@ namespace PhotonMapper
         vector<SharedShader> shaderPrograms;
         vector<Photon> photons;
         KDTree photonMap;
-        SharedBVHTree bvhTree = nullptr;
+        Accel::SharedSceneAccel accel = nullptr;  //场景的两层BVH
     public:
         PhotonMapperRenderer(SharedScene spScene)
             : spScene               (spScene)
@@ -47,6 +49,8 @@ namespace PhotonMapper
             height = scene.renderOption.height;
             depth = scene.renderOption.depth;
             samples = scene.renderOption.samplesPerPixel;
+            seed = scene.renderOption.randomSeed;
+            sampleMethod = scene.renderOption.sampleMethod;
             photonNum = scene.renderOption.photonNum;
             samplePhotonNum = scene.renderOption.samplePhotonNum;
             /*getServer().logger.log("width: " + to_string(width));
@@ -68,13 +72,14 @@ namespace PhotonMapper
         RGB gamma(const RGB& rgb);
         RGB trace(const Ray& ray, int currDepth);
         HitRecord closestHitObject(const Ray& r);
+        bool occluded(const Ray& r, float tMax);
         tuple<float, Vec3> closestHitLight(const Ray& r);
         void generatePhotonMap();
         void tracePhoton(const Ray& ray, const RGB& power, int depth);
 
         RGB OptTrace(const Ray &ray, int currDepth);
         void OptTracePhoton(const Ray &ray, const RGB &power, int depth);
-        tuple<Vec3, Vec3> sampleOnlight(const AreaLight &light);
+        tuple<Vec3, Vec3> sampleOnlight(const Accel::AreaLightRecord &light);
     };
 }
 
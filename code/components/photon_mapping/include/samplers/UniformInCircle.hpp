@@ -7,23 +7,29 @@
 namespace PhotonMapper
 {
     using namespace std;
-    class UniformInCircle : public Sampler2d  //UniformInCircle算法生成均匀分布在单位圆内的随机二维向量
+    class UniformInCircle final : public Sampler2d  //UniformInCircle算法生成均匀分布在单位圆内的随机二维向量
     {
     private:
-        default_random_engine e;
-        uniform_real_distribution<float> u;
+        constexpr static float C_PI_2 = 1.57079632679489661923f;
+        constexpr static float C_PI_4 = 0.78539816339744830962f;
     public:
-        UniformInCircle()
-            : e               ((unsigned int)time(0) + insideSeed())
-            , u               (-1, 1)
-        {}
+        UniformInCircle() = default;
         Vec2 sample2d() override {
-            float x{0}, y{0};
-            do {
-                x = u(e);
-                y = u(e);
-            } while((x*2 + y*2) > 1);
-            return { x, y };
+            //同心圆映射(Shirley-Chiu)把正方形一一映射到圆盘, 每次恰好消耗一组二维, 低差异点的分层得以保留
+            auto r = RandomStream::current().next2D();
+            float a = r.x * 2 - 1;
+            float b = r.y * 2 - 1;
+            if (a == 0 && b == 0) return { 0, 0 };
+            float radius, phi;
+            if (a*a > b*b) {
+                radius = a;
+                phi = C_PI_4 * (b / a);
+            }
+            else {
+                radius = b;
+                phi = C_PI_2 - C_PI_4 * (a / b);
+            }
+            return { radius * cos(phi), radius * sin(phi) };
         }
     
     };
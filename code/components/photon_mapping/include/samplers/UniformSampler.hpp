@@ -3,25 +3,18 @@
 #define __UNIFORM_SAMPLER_HPP__
 
 #include "Sampler1d.hpp"
-#include <ctime>
 
 namespace PhotonMapper
 {
     using namespace std;
-    class UniformSampler : public Sampler1d
+    class UniformSampler final : public Sampler1d
     {
-    private:
-        default_random_engine e;
-        uniform_real_distribution<float> u;
     public:
-        UniformSampler()
-            : e                 ((unsigned int)time(0) + insideSeed())
-            , u                 (0, 1)
-        {}
+        UniformSampler() = default;
         float sample1d() override {
-            return u(e);
+            return RandomStream::current().nextFloat();
         }
     };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -26,6 +26,7 @@ namespace PhotonMapper
             for (int j = 0; j < width; j++) {
                 Vec3 color{ 0, 0, 0 };
                 for (int k = 0; k < samples; k++) {
+                    RandomStream::begin(j, i, k, seed, sampleMethod);
                     auto r = defaultSamplerInstance<UniformInSquare>().sample2d();
                     float rx = r.x;
                     float ry = r.y;
@@ -45,6 +46,7 @@ namespace PhotonMapper
     }
 
     auto PhotonMapperRenderer::render() -> RenderResult {
+        Accel::Stats::reset();  //其他渲染组件留下的计数不计入本次渲染
         // shaders
         shaderPrograms.clear();
         ShaderCreator shaderCreator{};
@@ -57,12 +59,7 @@ namespace PhotonMapper
         // 局部坐标转换成世界坐标
         VertexTransformer vertexTransformer{};
         vertexTransformer.exec(spScene);
-        this->bvhTree = make_shared<BVHTree>(spScene);
-
-        for(auto &areaLight : scene.areaLightBuffer) {
-            areaLight.area = glm::length(glm::cross(areaLight.u, areaLight.v));
-            areaLight.normal = glm::normalize(glm::cross(areaLight.u, areaLight.v));
-		}
+        accel = make_shared<Accel::SceneAccel>(spScene);    //面光源的面积与法线在此一并预先计算
         generatePhotonMap();
 
         const auto taskNums = 16;
@@ -76,28 +73,13 @@ namespace PhotonMapper
         }
         //renderTask(pixels, width, height);
         getServer().logger.log("Done...");
+        accel->logStats();
 
         return { pixels, width, height };
     }
 
-    class RandomGenerator {
-    public:
-        RandomGenerator()
-            : generator(std::random_device{}()), distribution(0.0f, 1.0f) {}
-
-        float generate() {
-            return distribution(generator);
-        }
-
-    private:
-        std::mt19937 generator;
-        std::uniform_real_distribution<float> distribution;
-    };
-
-
     static float random_double() {
-		RandomGenerator generator;
-		return generator.generate();
+		return RandomStream::current().nextFloat();
 	}
 
     static bool russian_roulette(float p) {
@@ -109,7 +91,8 @@ namespace PhotonMapper
         getServer().logger.log("Photon trace generated...");
         for (int i = 0; i < photonNum; i++)
         {
-            for (auto &areaLight : scene.areaLightBuffer)
+            RandomStream::begin(0, height, i, seed, sampleMethod);  //光子放在图像之外的一行, 以光子序号作为采样序号
+            for (auto &areaLight : accel->areaLights())
             {
                 auto r1 = random_double();
                 auto r2 = random_double();
@@ -186,7 +169,7 @@ namespace PhotonMapper
     HitRecord PhotonMapperRenderer::closestHitObject(const Ray& r) {
         HitRecord closestHit = nullopt;
         float closest = FLOAT_INF;
-        auto hitRecord = Intersection::xBVH(r, bvhTree->root, 0.000001, closest); //BVH加速
+        auto hitRecord = accel->closestHit(r, 0.000001, closest); //BVH加速
         if (hitRecord && hitRecord->t < closest) {
             closest = hitRecord->t;
             return hitRecord;
@@ -215,10 +198,14 @@ namespace PhotonMapper
         return closestHit; 
     }
     
+    bool PhotonMapperRenderer::occluded(const Ray& r, float tMax) {
+        return accel->occluded(r, 0.000001, tMax);
+    }
+    
     tuple<float, Vec3> PhotonMapperRenderer::closestHitLight(const Ray& r) {
         Vec3 v = {};
         HitRecord closest = getHitRecord(FLOAT_INF, {}, {}, {});  //使用INF初始化,表示最近交点在无穷远处
-        for (auto& a : scene.areaLightBuffer) {
+        for (auto& a : accel->areaLights()) {
             auto hitRecord = Intersection::xAreaLight(r, a, 0.000001, closest->t); //计算光线r与区域光源a的交点，得到一个HitRecord类型的对象hitRecord
             if (hitRecord && closest->t > hitRecord->t) { //ray r 和区域光有交点
                 closest = hitRecord;
@@ -348,13 +335,10 @@ namespace PhotonMapper
         }
     }
 
-    tuple<Vec3, Vec3> PhotonMapperRenderer::sampleOnlight(const AreaLight &light) {
-        Vec3 p = light.position;
-        Vec3 u = light.u;
-        Vec3 v = light.v;
-        Vec3 normal = glm::normalize(glm::cross(u, v));
-        Vec3 samplePoint = p + u * defaultSamplerInstance<UniformSampler>().sample1d() + v * defaultSamplerInstance<UniformSampler>().sample1d();
-        return { samplePoint, normal };
+    tuple<Vec3, Vec3> PhotonMapperRenderer::sampleOnlight(const Accel::AreaLightRecord &light) {
+        auto r = defaultSamplerInstance<UniformInSquare>().sample2d();    //光源上的两维作为一组联合分层
+        Vec3 samplePoint = light.position + light.u * ((r.x + 1) * 0.5f) + light.v * ((r.y + 1) * 0.5f);
+        return { samplePoint, light.normal };
     }
 
     RGB PhotonMapperRenderer::OptTrace(const Ray &r, int currDepth) {
@@ -370,19 +354,18 @@ namespace PhotonMapper
                 auto attenuation = scattered.attenuation;
                 auto emitted = scattered.emitted;
 
-                auto [samplePoint, normal] = sampleOnlight(scene.areaLightBuffer[0]);
+                auto [samplePoint, normal] = sampleOnlight(accel->areaLights()[0]);
                 Vec3 shadowRayDir = glm::normalize(samplePoint - hitObject->hitPoint);
                 Ray shadowRay{ hitObject->hitPoint, shadowRayDir };
-                auto shadowHit = closestHitObject(shadowRay);
                 float distance2Light = glm::length(samplePoint - hitObject->hitPoint);
                 float cosTheta = glm::dot(-shadowRayDir, normal);
                 Vec3 L_dir;
-                auto radiance = scene.areaLightBuffer[0].radiance;  //直接光照
-                if (shadowHit && shadowHit->t < distance2Light || cosTheta < 0.0001) {  //如果被遮挡， 或与光源法向量夹角过小
+                auto radiance = accel->areaLights()[0].radiance;  //直接光照
+                if (cosTheta < 0.0001 || occluded(shadowRay, distance2Light)) {  //如果与光源法向量夹角过小, 或被遮挡
                     L_dir = Vec3(0.f);
                 }
                 else {
-                    float pdf_light = 1.0f / (glm::length(scene.areaLightBuffer[0].u) * glm::length(scene.areaLightBuffer[0].v)); // 光源pdf, 1/A
+                    float pdf_light = 1.0f / accel->areaLights()[0].area; // 光源pdf, 1/A
                     float n_dot_in_light = glm::dot(hitObject->normal, shadowRayDir);
                     Vec3 directLighting = radiance * n_dot_in_light * cosTheta / (distance2Light * distance2Light * pdf_light);
                     L_dir = attenuation * directLighting;
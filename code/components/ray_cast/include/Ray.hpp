@@ -2,46 +2,15 @@
 #ifndef __RAY_HPP__
 #define __RAY_HPP__
 
-#include "geometry/vec.hpp"
+#include "accel/Ray.hpp"
 
-#include <limits>
-
-#define FLOAT_INF numeric_limits<float>::infinity()
 namespace RayCast
 {
     using namespace NRenderer;
     using namespace std;
 
-
-    struct Ray
-    {
-        Vec3 origin;
-        // keep it as a unit vector
-        Vec3 direction;
-
-        void setOrigin(const Vec3& v) {
-            origin = v;
-        }
-
-        void setDirection(const Vec3& v) {
-            direction = glm::normalize(v);
-        }
-
-        inline
-        Vec3 at(float t) const {
-            return origin + t*direction;
-        }
-
-        Ray(const Vec3& origin, const Vec3& direction)
-            : origin                (origin)
-            , direction             (direction)
-        {}
-    
-        Ray()
-            : origin        {}
-            , direction     {}
-        {}
-    };
+    // 光线类型由加速结构库NRAccel提供, 各渲染组件共用
+    using Accel::Ray;
 }
 
 #endif
\ No newline at end of file
@@ -6,6 +6,7 @@
 
 #include "Camera.hpp"
 #include "intersections/intersections.hpp"
+#include "accel/SceneAccel.hpp"
 
 #include "shaders/ShaderCreator.hpp"
 
@@ -18,6 +19,7 @@ namespace RayCast
         SharedScene spScene;
         Scene& scene;
         RayCast::Camera camera;
+        Accel::SharedSceneAccel accel = nullptr;  //场景的BVH
 
         vector<SharedShader> shaderPrograms;
     public:
@@ -2,19 +2,14 @@
 #ifndef __INTERSECTIONS_HPP__
 #define __INTERSECTIONS_HPP__
 
-#include "HitRecord.hpp"
+#include "intersections/HitRecord.hpp"
 #include "Ray.hpp"
-#include "scene/Scene.hpp"
+#include "accel/intersections.hpp"
 
 namespace RayCast
 {
-    namespace Intersection
-    {
-        HitRecord xTriangle(const Ray& ray, const Triangle& t, float tMin = 0.f, float tMax = FLOAT_INF);
-        HitRecord xSphere(const Ray& ray, const Sphere& s, float tMin = 0.f, float tMax = FLOAT_INF);
-        HitRecord xPlane(const Ray& ray, const Plane& p, float tMin = 0.f, float tMax = FLOAT_INF);
-        HitRecord xAreaLight(const Ray& ray, const AreaLight& a, float tMin = 0.f, float tMax = FLOAT_INF);
-    }
+    // 求交与BVH遍历由加速结构库NRAccel提供
+    namespace Intersection = Accel::Intersection;
 }
 
 #endif
\ No newline at end of file
@@ -12,12 +12,14 @@ namespace RayCast
         return glm::sqrt(rgb);
     }
     auto RayCastRenderer::render() -> RenderResult {
+        Accel::Stats::reset();  //其他渲染组件留下的计数不计入本次渲染
         auto width = scene.renderOption.width;
         auto height = scene.renderOption.height;
         auto pixels = new RGBA[width*height];
 
         VertexTransformer vertexTransformer{};
         vertexTransformer.exec(spScene);
+        accel = make_shared<Accel::SceneAccel>(spScene);
 
         ShaderCreator shaderCreator{};
         for (auto& mtl : scene.materials) {
@@ -33,6 +35,7 @@ namespace RayCast
                 pixels[(height-i-1)*width+j] = {color, 1}; //将颜色值存入像素数组,注意这里的坐标系是左下角为原点
             }
         }
+        accel->logStats();
 
         return {pixels, width, height};
     }
@@ -49,9 +52,8 @@ namespace RayCast
             }
             auto distance = glm::length(l.position - hitRec.hitPoint); //光源到交点的距离
             auto shadowRay = Ray{hitRec.hitPoint, out}; //阴影光线
-            auto shadowHit = closestHit(shadowRay);
             auto c = shaderPrograms[hitRec.material.index()]->shade(-r.direction, out, hitRec.normal);
-            if ((!shadowHit) || (shadowHit && shadowHit->t > distance)) {
+            if (!accel->occluded(shadowRay, 0.01, distance)) {  //阴影光线只需判断是否被遮挡
                 return c * l.intensity;
             }
             else {
@@ -64,29 +66,6 @@ namespace RayCast
     }
 
     HitRecord RayCastRenderer::closestHit(const Ray& r) {
-        HitRecord closestHit = nullopt;
-        float closest = FLOAT_INF;
-        for (auto& s : scene.sphereBuffer) {    //遍历所有球体
-            auto hitRecord = Intersection::xSphere(r, s, 0.01, closest);
-            if (hitRecord && hitRecord->t < closest) {  //找到距离最近的交点
-                closest = hitRecord->t;
-                closestHit = hitRecord;
-            }
-        }
-        for (auto& t : scene.triangleBuffer) {  //遍历所有三角形
-            auto hitRecord = Intersection::xTriangle(r, t, 0.01, closest);
-            if (hitRecord && hitRecord->t < closest) {
-                closest = hitRecord->t;
-                closestHit = hitRecord;
-            }
-        }
-        for (auto& p : scene.planeBuffer) {//遍历所有平面
-            auto hitRecord = Intersection::xPlane(r, p, 0.01, closest);
-            if (hitRecord && hitRecord->t < closest) {
-                closest = hitRecord->t;
-                closestHit = hitRecord;
-            }
-        }
-        return closestHit; 
+        return accel->closestHit(r, 0.01, FLOAT_INF);  //BVH加速
     }
 }
\ No newline at end of file
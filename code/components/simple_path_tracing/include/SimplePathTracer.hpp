@@ -7,6 +7,7 @@
 #include "Camera.hpp"
 #include "intersections/HitRecord.hpp"
 #include "shaders/ShaderCreator.hpp"
+#include "accel/SceneAccel.hpp"
 
 #include <tuple>
 namespace SimplePathTracer
@@ -25,11 +26,14 @@ namespace SimplePathTracer
         unsigned int height;
         unsigned int depth;     //最大的trace递归数目
         unsigned int samples; //采样的光线数
+        unsigned int seed;  //随机数种子, 与像素和采样序号一起决定每个采样的随机数流
+        SampleMethod sampleMethod;
 
         using SCam = SimplePathTracer::Camera;
         SCam camera;
 
         vector<SharedShader> shaderPrograms;
+        Accel::SharedSceneAccel accel = nullptr;  //场景的两层BVH
     public:
         SimplePathTracerRenderer(SharedScene spScene)
             : spScene               (spScene)
@@ -40,6 +44,8 @@ namespace SimplePathTracer
             height = scene.renderOption.height;
             depth = scene.renderOption.depth;
             samples = scene.renderOption.samplesPerPixel;
+            seed = scene.renderOption.randomSeed;
+            sampleMethod = scene.renderOption.sampleMethod;
         }
         ~SimplePathTracerRenderer() = default;
 
@@ -54,8 +60,6 @@ namespace SimplePathTracer
         RGB trace(const Ray& ray, int currDepth);
         HitRecord closestHitObject(const Ray& r);
         tuple<float, Vec3> closestHitLight(const Ray& r);
-
-        void handleMesh();
     };
 }
 
@@ -2,22 +2,13 @@
 #ifndef __SAMPLER_HPP__
 #define __SAMPLER_HPP__
 
-#include <mutex>
+#include "Random.hpp"
 
 namespace SimplePathTracer
 {
-    using std::mutex;   //mutex锁
+    // 采样器本身没有状态, 随机数都取自当前线程的RandomStream
     class Sampler
     {
-    protected:
-        static int insideSeed() {
-            static mutex m;
-            static int seed = 0;
-            m.lock();
-            seed++;
-            m.unlock();
-            return seed;
-        }
     public:
         virtual ~Sampler() = default;
         Sampler() = default;
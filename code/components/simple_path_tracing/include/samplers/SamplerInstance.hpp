@@ -16,7 +16,7 @@ namespace SimplePathTracer
             is_base_of<Sampler1d, T>::value ||
             is_base_of<Sampler2d, T>::value ||
             is_base_of<Sampler3d, T>::value, "Not a sampler type.");
-        thread_local static T t{};
+        static T t{};   //采样器没有状态, 各线程共用一个实例
         return t;
     }
 }
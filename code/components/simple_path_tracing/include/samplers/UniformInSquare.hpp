@@ -3,25 +3,19 @@
 #define __UNIFORM_IN_SQUARE_HPP__
 
 #include "Sampler2d.hpp"
-#include <ctime>
 
 namespace SimplePathTracer
 {
     using namespace std;
-    class UniformInSquare: public Sampler2d //UniformInSquare算法生成均匀分布在单位正方形内的随机二维向量
+    class UniformInSquare final : public Sampler2d //UniformInSquare算法生成均匀分布在单位正方形内的随机二维向量
     {
-    private:
-        default_random_engine e;
-        uniform_real_distribution<float> u;
     public:
-        UniformInSquare()
-            : e               ((unsigned int)time(0) + insideSeed())
-            , u               (-1, 1)
-        {}
+        UniformInSquare() = default;
         Vec2 sample2d() override {
-            return {u(e), u(e)};
+            auto r = RandomStream::current().next2D();
+            return {r.x * 2 - 1, r.y * 2 - 1};    //[-1, 1)
         }
     };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -9,22 +9,6 @@
 
 namespace SimplePathTracer
 {
-    void SimplePathTracerRenderer::handleMesh() {  //处理mesh
-        for (auto& m : scene.meshBuffer) {
-            
-            for(int i = 0; i < m.positionIndices.size(); i += 3){  //每三个为一个三角形
-                Triangle tr = Triangle{};
-                tr.v1 = m.positions[m.positionIndices[i]];
-                tr.v2 = m.positions[m.positionIndices[i+1]];
-                tr.v3 = m.positions[m.positionIndices[i+2]];
-                tr.material = m.material;
-                tr.normal = glm::normalize(glm::cross(tr.v2 - tr.v1, tr.v3 - tr.v1));
-                scene.triangleBuffer.push_back(tr);
-            }
-                
-        }
-    }
-
     RGB SimplePathTracerRenderer::gamma(const RGB& rgb) {
         return glm::sqrt(rgb);
     }
@@ -34,6 +18,7 @@ namespace SimplePathTracer
             for (int j=0; j<width; j++) {
                 Vec3 color{0, 0, 0};
                 for (int k=0; k < samples; k++) {
+                    RandomStream::begin(j, i, k, seed, sampleMethod);
                     auto r = defaultSamplerInstance<UniformInSquare>().sample2d();
                     float rx = r.x;
                     float ry = r.y;
@@ -41,6 +26,7 @@ namespace SimplePathTracer
                     float y = (float(i)+ry)/float(height); //随机采样的光线方向
                     auto ray = camera.shoot(x, y); //打出光线
                     color += trace(ray, 0); //路径追踪渲染
+                    Accel::Stats::add(Accel::Stats::Counter::PATHS);
                 }
                 color /= samples; //平均
                 color = gamma(color);
@@ -50,6 +36,7 @@ namespace SimplePathTracer
     }
 
     auto SimplePathTracerRenderer::render() -> RenderResult {
+        Accel::Stats::reset();  //其他渲染组件留下的计数不计入本次渲染
         // shaders
         shaderPrograms.clear();
         ShaderCreator shaderCreator{};
@@ -63,7 +50,7 @@ namespace SimplePathTracer
         VertexTransformer vertexTransformer{};
         vertexTransformer.exec(spScene);
 
-        handleMesh(); //处理mesh
+        accel = make_shared<Accel::SceneAccel>(spScene);  //Mesh以实例的形式加入BVH
 
         const auto taskNums = 16;
         thread t[taskNums];
@@ -75,9 +62,7 @@ namespace SimplePathTracer
             t[i].join();
         }
         getServer().logger.log("Done...");
-        int64_t totalIntersections = Intersection::getIntersectionCount();
-        cout << "Simple intersection calls: " << totalIntersections<<"with Sample: "<<samples<< std::endl;
-        Intersection::resetIntersectionCount();
+        accel->logStats();
         return {pixels, width, height};
     }
 
@@ -87,41 +72,13 @@ namespace SimplePathTracer
     }
 
     HitRecord SimplePathTracerRenderer::closestHitObject(const Ray& r) {
-        HitRecord closestHit = nullopt;
-        float closest = FLOAT_INF;
-
-        for (auto& s : scene.sphereBuffer) {
-
-            auto hitRecord = Intersection::xSphere(r, s, 0.000001, closest);
-            if (hitRecord && hitRecord->t < closest) {
-                closest = hitRecord->t;
-                closestHit = hitRecord;
-            }
-        }
-        for (auto& t : scene.triangleBuffer) {
-
-            auto hitRecord = Intersection::xTriangle(r, t, 0.000001, closest);
-            if (hitRecord && hitRecord->t < closest) {
-                closest = hitRecord->t;
-                closestHit = hitRecord;
-            }
-        }
-        for (auto& p : scene.planeBuffer) {
-
-            auto hitRecord = Intersection::xPlane(r, p, 0.000001, closest);
-            if (hitRecord && hitRecord->t < closest) {
-                closest = hitRecord->t;
-                closestHit = hitRecord;
-            }
-        }
-        
-        return closestHit; 
+        return accel->closestHit(r, 0.000001, FLOAT_INF);  //BVH加速
     }
     
     tuple<float, Vec3> SimplePathTracerRenderer::closestHitLight(const Ray& r) {
         Vec3 v = {};
         HitRecord closest = getHitRecord(FLOAT_INF, {}, {}, {});  //使用INF初始化,表示最近交点在无穷远处
-        for (auto& a : scene.areaLightBuffer) {
+        for (auto& a : accel->areaLights()) {
             auto hitRecord = Intersection::xAreaLight(r, a, 0.000001, closest->t); //计算光线r与区域光源a的交点，得到一个HitRecord类型的对象hitRecord
             if (hitRecord && closest->t > hitRecord->t) { //ray r 和区域光有交点
                 closest = hitRecord;
@@ -12,12 +12,47 @@ namespace NRenderer
 {
     struct RenderOption
     {
+        // BVH的划分方式
+        enum class BVHSplitMethod
+        {
+            MIDPOINT,       // 最长轴中点划分
+            SAH,            // 分桶的表面积启发式(Surface Area Heuristic)划分
+            LBVH,           // 按Morton码排序后线性构建, 构建最快
+            LBVH_TREELET,   // LBVH之后再做treelet重构, 恢复一部分SAH质量
+            SBVH            // 在SAH的基础上允许空间划分, 跨越划分平面的图元被裁剪后复制到两侧
+        };
+        // BVH的节点布局
+        enum class BVHLayout
+        {
+            BINARY,     // 二叉树
+            BVH4,       // 4叉树, SSE一次测试4个孩子的包围盒
+            BVH8,       // 8叉树, AVX一次测试8个孩子的包围盒
+            BVH8_COMPRESSED // 8叉树, 孩子包围盒量化为8位坐标, 节点内存约为BVH8的一半
+        };
+        // 路径追踪中各维度随机数的生成方式
+        enum class SampleMethod
+        {
+            RANDOM,     // 独立的伪随机数
+            SOBOL,      // Owen置乱的Sobol序列, 按二维一组发放
+            HALTON,     // 每个像素随机平移的Halton序列
+            BLUE_NOISE  // 所有像素共用Sobol序列, 按抖动图平移, 误差在屏幕上呈蓝噪声分布
+        };
         unsigned int width;
         unsigned int height;
         unsigned int depth;
         unsigned int samplesPerPixel;
         unsigned int photonNum;
         unsigned int samplePhotonNum;
+        BVHSplitMethod bvhSplitMethod;
+        BVHLayout bvhLayout;
+        bool bvhDiskCache;      // 是否把构建好的BVH写入磁盘缓存, 几何不变时直接载入
+        unsigned int bvhMaxLeafSize;    // BVH叶结点最多包含的图元数
+        unsigned int rayPacketSize;     // 主光线与阴影光线成包遍历时每包的光线数(4, 8, 16), 1为逐条遍历
+        bool bvhBenchmark;              // 渲染结束后用额外的主光线比较各BVH布局, 以及成包与逐条遍历的速度
+        unsigned int randomSeed;        // 随机数种子, 种子相同时渲染结果相同
+        SampleMethod sampleMethod;
+        bool adaptiveSampling;          // 是否按像素的误差估计分配采样, 总采样数仍为samplesPerPixel * 像素数
+        float adaptiveThreshold;        // 自适应采样时相对标准误差低于该值的像素不再追加采样
         RenderOption()
             : width             (500)
             , height            (500)
@@ -25,6 +60,16 @@ namespace NRenderer
             , samplesPerPixel   (16)
             , photonNum         (100000)
             , samplePhotonNum   (10)
+            , bvhSplitMethod    (BVHSplitMethod::SAH)
+            , bvhLayout         (BVHLayout::BINARY)
+            , bvhDiskCache      (true)
+            , bvhMaxLeafSize    (4)
+            , rayPacketSize     (1)
+            , bvhBenchmark      (false)
+            , randomSeed        (0)
+            , sampleMethod      (SampleMethod::RANDOM)
+            , adaptiveSampling  (false)
+            , adaptiveThreshold (0.05f)
         {}
     };
 
@@ -0,0 +1,328 @@
+#include "gtest/gtest.h"
+#include "accel/SceneAccel.hpp"
+#include "accel/intersections.hpp"
+
+#include <filesystem>
+#include <random>
+#include <thread>
+
+using namespace NRenderer;
+using namespace Accel;
+
+// 随机场景上, 加速结构的查询结果应与逐个图元求交一致
+class AccelTest : public ::testing::Test
+{
+public:
+    AccelTest() = default;
+    ~AccelTest() = default;
+    void SetUp() override {
+        spScene = make_shared<Scene>();
+        auto& scene = *spScene;
+        scene.renderOption.bvhDiskCache = false;
+        scene.models.push_back(Model{});
+        Model moved{};
+        moved.translation = {1, 2, 3};
+        moved.scale = {2, 1, 0.5f};
+        scene.models.push_back(moved);
+
+        mt19937 rng(7);
+        uniform_real_distribution<float> pos(-5, 5), size(0.1f, 0.8f);
+        for (int i = 0; i < 30; i++) {
+            Sphere s;
+            s.position = {pos(rng), pos(rng), pos(rng)};
+            s.radius = size(rng);
+            scene.sphereBuffer.push_back(s);
+            scene.nodes.push_back(Node{Node::Type::SPHERE, Index(i), 0});
+        }
+        for (int i = 0; i < 30; i++) {
+            Triangle t;
+            Vec3 c{pos(rng), pos(rng), pos(rng)};
+            t.v1 = c;
+            t.v2 = c + Vec3{size(rng), 0, size(rng)};
+            t.v3 = c + Vec3{0, size(rng), size(rng)};
+            t.normal = glm::normalize(glm::cross(t.v2 - t.v1, t.v3 - t.v1));
+            scene.triangleBuffer.push_back(t);
+            scene.nodes.push_back(Node{Node::Type::TRIANGLE, Index(i), 0});
+        }
+        Plane plane;
+        plane.position = {-5, -5.5f, -5};
+        plane.u = {10, 0, 0};
+        plane.v = {0, 1, 10};
+        plane.normal = glm::normalize(glm::cross(plane.u, plane.v));
+        scene.planeBuffer.push_back(plane);
+        scene.nodes.push_back(Node{Node::Type::PLANE, 0, 0});
+        Mesh mesh;
+        for (int i = 0; i < 200; i++) {
+            Vec3 c{pos(rng), pos(rng), pos(rng)};
+            for (int k = 0; k < 3; k++) {
+                mesh.positions.push_back(c + Vec3{size(rng), size(rng), size(rng)});
+                mesh.positionIndices.push_back(Index(mesh.positions.size() - 1));
+            }
+        }
+        scene.meshBuffer.push_back(mesh);
+        scene.nodes.push_back(Node{Node::Type::MESH, 0, 1});
+
+        //逐个图元求交的参照: Mesh按模型变换展开为世界空间的三角形
+        for (size_t i = 0; i < mesh.positionIndices.size(); i += 3) {
+            Triangle t;
+            for (int k = 0; k < 3; k++) t.v[k] = mesh.positions[mesh.positionIndices[i + k]] * moved.scale + moved.translation;
+            t.normal = glm::normalize(glm::cross(t.v2 - t.v1, t.v3 - t.v1));
+            meshTriangles.push_back(t);
+        }
+        for (int i = 0; i < 500; i++) {
+            Vec3 dir = glm::normalize(Vec3{pos(rng), pos(rng), pos(rng)});
+            rays.emplace_back(Vec3{pos(rng), pos(rng), pos(rng)}, dir);
+        }
+    }
+
+    HitRecord bruteForce(const Ray& r, float tMin, float tMax) {
+        HitRecord closest = nullopt;
+        auto update = [&](const HitRecord& h) {
+            if (h && h->t < tMax) {
+                tMax = h->t;
+                closest = h;
+            }
+        };
+        for (auto& s : spScene->sphereBuffer) update(Intersection::xSphere(r, s, tMin, tMax));
+        for (auto& t : spScene->triangleBuffer) update(Intersection::xTriangle(r, t, tMin, tMax));
+        for (auto& t : meshTriangles) update(Intersection::xTriangle(r, t, tMin, tMax));
+        for (auto& p : spScene->planeBuffer) update(Intersection::xPlane(r, makePlaneRecord(p), tMin, tMax));
+        return closest;
+    }
+
+    SharedScene spScene;
+    vector<Triangle> meshTriangles;
+    vector<Ray> rays;
+};
+
+TEST_F(AccelTest, MatchesBruteForce) {
+    using Layout = RenderOption::BVHLayout;
+    using SplitMethod = RenderOption::BVHSplitMethod;
+    for (auto method : {SplitMethod::MIDPOINT, SplitMethod::SAH, SplitMethod::LBVH, SplitMethod::LBVH_TREELET, SplitMethod::SBVH}) {
+        for (auto layout : {Layout::BINARY, Layout::BVH4, Layout::BVH8, Layout::BVH8_COMPRESSED}) {
+            spScene->renderOption.bvhSplitMethod = method;
+            spScene->renderOption.bvhLayout = layout;
+            SceneAccel accel{spScene};
+            for (auto& r : rays) {
+                auto expected = bruteForce(r, 0.0001f, FLOAT_INF);
+                auto hit = accel.closestHit(r, 0.0001f, FLOAT_INF);
+                ASSERT_EQ(bool(hit), bool(expected)) << "split method " << int(method) << ", layout " << int(layout);
+                if (hit) EXPECT_NEAR(hit->t, expected->t, 1e-3f);
+                float tMax = 4.f;
+                EXPECT_EQ(accel.occluded(r, 0.0001f, tMax), expected && expected->t < tMax);
+            }
+        }
+    }
+}
+
+// 图元移动后重新拟合的BVH应与移动后的场景一致; 场景结构变化时拒绝重新拟合
+TEST_F(AccelTest, RefitAfterMotion) {
+    spScene->nodes.pop_back();  //顶层BVH直接包含Mesh的三角形时不做模型变换, 这里只保留球, 三角形与平面
+    meshTriangles.clear();
+    BVHTree bvh{spScene, RenderOption::BVHSplitMethod::SAH, nullptr, 4};
+
+    mt19937 rng(11);
+    uniform_real_distribution<float> offset(-1.5f, 1.5f);
+    auto motion = [&]() { return Vec3{offset(rng), offset(rng), offset(rng)}; };
+    for (auto& s : spScene->sphereBuffer) s.position += motion();
+    for (auto& t : spScene->triangleBuffer) {
+        for (int k = 0; k < 3; k++) t.v[k] += motion();
+        t.normal = glm::normalize(glm::cross(t.v2 - t.v1, t.v3 - t.v1));
+    }
+    for (auto& p : spScene->planeBuffer) p.position += motion();
+    ASSERT_TRUE(bvh.refit(spScene));
+
+    for (auto& r : rays) {
+        auto expected = bruteForce(r, 0.0001f, FLOAT_INF);
+        auto hit = Intersection::xBVH(r, bvh, 0.0001f, FLOAT_INF);
+        ASSERT_EQ(bool(hit), bool(expected));
+        if (hit) EXPECT_NEAR(hit->t, expected->t, 1e-3f);
+        EXPECT_EQ(Intersection::occluded(r, bvh, 0.0001f, 4.f), expected && expected->t < 4.f);
+    }
+
+    //被拒绝的重新拟合不应改动原有的树, 重复加入的球不改变最近交点
+    spScene->nodes.push_back(Node{Node::Type::SPHERE, 0, 0});
+    EXPECT_FALSE(bvh.refit(spScene));
+    for (auto& r : rays) {
+        auto expected = bruteForce(r, 0.0001f, FLOAT_INF);
+        auto hit = Intersection::xBVH(r, bvh, 0.0001f, FLOAT_INF);
+        ASSERT_EQ(bool(hit), bool(expected));
+        if (hit) EXPECT_NEAR(hit->t, expected->t, 1e-3f);
+    }
+}
+
+// 写入磁盘缓存后载入的Mesh BVH应与原BVH的结构和求交结果相同; 构建设置不同的文件视为过期
+TEST_F(AccelTest, DiskCacheRoundTrip) {
+    using SplitMethod = RenderOption::BVHSplitMethod;
+    auto directory = filesystem::temp_directory_path() / "nr_accel_test_cache";
+    filesystem::remove_all(directory);
+    BVHDiskCache cache{directory.string()};
+    const Mesh& mesh = spScene->meshBuffer[0];
+    uint64_t key = MeshBVHCache::hashMesh(mesh);
+    EXPECT_EQ(cache.load(key, mesh, SplitMethod::SAH), nullptr);
+
+    BVHTree built{mesh, SplitMethod::SAH, 4};
+    cache.save(key, built);
+    auto loaded = cache.load(key, mesh, SplitMethod::SAH);
+    ASSERT_NE(loaded, nullptr);
+    EXPECT_EQ(loaded->nodes.size(), built.nodes.size());
+    EXPECT_EQ(loaded->leafIndices, built.leafIndices);
+    for (auto& r : rays) {
+        auto expected = Intersection::xBVH(r, built, 0.0001f, FLOAT_INF);
+        auto hit = Intersection::xBVH(r, *loaded, 0.0001f, FLOAT_INF);
+        ASSERT_EQ(bool(hit), bool(expected));
+        if (hit) EXPECT_EQ(hit->t, expected->t);
+    }
+    EXPECT_EQ(cache.load(key, mesh, SplitMethod::MIDPOINT), nullptr);
+
+    //节点下标越界的文件同样视为过期
+    int root = built.nodes[0].secondChildOffset;
+    built.nodes[0].secondChildOffset = int(built.nodes.size());
+    cache.save(key, built);
+    EXPECT_EQ(cache.load(key, mesh, SplitMethod::SAH), nullptr);
+    built.nodes[0].secondChildOffset = root;
+    auto leaf = find_if(built.nodes.begin(), built.nodes.end(), [](const LinearBVHNode& n) { return n.nPrimitives > 0; });
+    leaf->primitiveOffset = int(built.leafIndices.size());
+    cache.save(key, built);
+    EXPECT_EQ(cache.load(key, mesh, SplitMethod::SAH), nullptr);
+    filesystem::remove_all(directory);
+}
+
+// 成包遍历的结果应与逐条光线一致, 包括从同一点射出的方向相近的光线与互不相关的光线
+TEST_F(AccelTest, PacketsMatchSingleRays) {
+    SceneAccel accel{spScene};
+    vector<Ray> packetRays = rays;
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 16; j++) {
+            packetRays.emplace_back(Vec3{0, 0, 12}, glm::normalize(Vec3{(j - 8) * 0.05f, (i - 8) * 0.05f, -1}));
+        }
+    }
+    const int maxSize = Intersection::MAX_PACKET_SIZE;
+    for (size_t first = 0, size = 1; first < packetRays.size(); first += size, size = size % maxSize + 1) {
+        int count = int(min(size, packetRays.size() - first));
+        const Ray* packet = packetRays.data() + first;
+        HitRecord hits[maxSize];
+        float tMax[maxSize];
+        bool occluded[maxSize];
+        accel.closestHitPacket(packet, count, 0.0001f, FLOAT_INF, hits);
+        for (int k = 0; k < count; k++) tMax[k] = 1.f + k;
+        accel.occludedPacket(packet, count, 0.0001f, tMax, occluded);
+        for (int k = 0; k < count; k++) {
+            auto expected = bruteForce(packet[k], 0.0001f, FLOAT_INF);
+            ASSERT_EQ(bool(hits[k]), bool(expected));
+            if (hits[k]) EXPECT_NEAR(hits[k]->t, expected->t, 1e-3f);
+            EXPECT_EQ(occluded[k], expected && expected->t < tMax[k]);
+        }
+    }
+}
+
+// 平面给出的法线不是单位长度时, 交点的法线仍应归一化
+TEST(AccelPlaneTest, HitNormalIsUnitLength) {
+    auto spScene = make_shared<Scene>();
+    spScene->renderOption.bvhDiskCache = false;
+    Plane plane;
+    plane.position = {-1, 0, -1};
+    plane.u = {2, 0, 0};
+    plane.v = {0, 0, 2};
+    plane.normal = {0, 3, 0};
+    spScene->planeBuffer.push_back(plane);
+    spScene->nodes.push_back(Node{Node::Type::PLANE, 0, 0});
+    SceneAccel accel{spScene};
+    Ray r{Vec3{0.2f, 5, 0.3f}, Vec3{0, -1, 0}};
+    auto hit = accel.closestHit(r, 0.0001f, FLOAT_INF);
+    ASSERT_TRUE(bool(hit));
+    EXPECT_NEAR(hit->t, 5.f, 1e-5f);
+    EXPECT_NEAR(glm::length(hit->normal), 1.f, 1e-5f);
+    EXPECT_NEAR(Intersection::xPlane(r, makePlaneRecord(plane))->normal.y, 1.f, 1e-5f);
+}
+
+// 射向网格顶点与共享边的光线, 任何布局下都不应从相邻三角形之间漏过
+TEST(AccelWatertightTest, SharedEdgesDoNotLeak) {
+    using Layout = RenderOption::BVHLayout;
+    auto spScene = make_shared<Scene>();
+    spScene->renderOption.bvhDiskCache = false;
+    spScene->models.push_back(Model{});
+    const int n = 40;
+    Mesh mesh;
+    for (int i = 0; i <= n; i++) {
+        for (int j = 0; j <= n; j++) {
+            float x = -5.f + 10.f * i / n, z = -5.f + 10.f * j / n;
+            mesh.positions.push_back({x, sinf(x * 1.3f) * cosf(z * 0.7f), z});
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            Index a = i * (n + 1) + j, b = a + 1, c = a + n + 1, d = c + 1;
+            for (Index v : {a, b, d, a, d, c}) mesh.positionIndices.push_back(v);
+        }
+    }
+    spScene->meshBuffer.push_back(mesh);
+    spScene->nodes.push_back(Node{Node::Type::MESH, 0, 0});
+
+    vector<Ray> rays;
+    for (int i = 1; i < n; i++) {
+        for (int j = 1; j < n; j++) {
+            const auto& p = mesh.positions;
+            Index a = i * (n + 1) + j, b = a + 1, c = a + n + 1, d = c + 1;
+            for (Vec3 target : {p[a], (p[a] + p[b]) * 0.5f, (p[a] + p[c]) * 0.5f, (p[a] + p[d]) * 0.5f}) {
+                Vec3 origin = target + Vec3{0.37f, 5.f, -0.21f};
+                rays.emplace_back(origin, glm::normalize(target - origin));
+            }
+        }
+    }
+    for (auto layout : {Layout::BINARY, Layout::BVH4, Layout::BVH8, Layout::BVH8_COMPRESSED}) {
+        spScene->renderOption.bvhLayout = layout;
+        SceneAccel accel{spScene};
+        int leaked = 0;
+        for (auto& r : rays) {
+            if (!accel.closestHit(r, 0.0001f, FLOAT_INF)) leaked++;
+            if (!accel.occluded(r, 0.0001f, FLOAT_INF)) leaked++;
+        }
+        EXPECT_EQ(leaked, 0) << "layout " << int(layout);
+    }
+}
+
+// 中心点按几何级数分布时, 中点与SAH划分每层只分出一个图元, 树的深度仍应受遍历栈的限制
+TEST(AccelDepthTest, GeometricSpacingStaysWithinStack) {
+    using SplitMethod = RenderOption::BVHSplitMethod;
+    auto spScene = make_shared<Scene>();
+    spScene->renderOption.bvhDiskCache = false;
+    spScene->renderOption.bvhMaxLeafSize = 1;
+    const int n = 180;
+    for (int i = 0; i < n; i++) {
+        Sphere s;
+        float x = ldexpf(1.f, i - 60);
+        s.position = {x, 0, 0};
+        s.radius = x * 0.25f;
+        spScene->sphereBuffer.push_back(s);
+        spScene->nodes.push_back(Node{Node::Type::SPHERE, Index(i), 0});
+    }
+    for (auto method : {SplitMethod::MIDPOINT, SplitMethod::SAH, SplitMethod::LBVH, SplitMethod::LBVH_TREELET, SplitMethod::SBVH}) {
+        spScene->renderOption.bvhSplitMethod = method;
+        SharedSceneAccel accel;
+        ASSERT_NO_THROW(accel = make_shared<SceneAccel>(spScene)) << "split method " << int(method);
+        for (int i = 50; i < 75; i++) {
+            float x = ldexpf(1.f, i - 60);
+            Ray r{Vec3{x, 0, 2 * x}, Vec3{0, 0, -1}};
+            auto hit = accel->closestHit(r, 0.0001f, FLOAT_INF);
+            ASSERT_TRUE(bool(hit)) << "split method " << int(method) << ", sphere " << i;
+            EXPECT_NEAR(hit->t, 1.75f * x, 1e-3f * x);
+            EXPECT_TRUE(accel->occluded(r, 0.0001f, FLOAT_INF));
+        }
+    }
+}
+
+#ifndef NR_ACCEL_NO_STATS
+// 线程结束后计数并入合计, 每轮新建的线程复用已释放的计数器
+TEST(RayStatsTest, CountsSurviveThreadExit) {
+    Stats::reset();
+    for (int round = 0; round < 3; round++) {
+        vector<thread> threads;
+        for (int i = 0; i < 8; i++) threads.emplace_back([] { Stats::add(Stats::Counter::RAYS, 5); });
+        for (auto& t : threads) t.join();
+        EXPECT_EQ(Stats::total(Stats::Counter::RAYS), 40 * (round + 1));
+    }
+    Stats::reset();
+    EXPECT_EQ(Stats::total(Stats::Counter::RAYS), 0);
+}
+#endif